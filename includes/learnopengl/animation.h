@@ -6,6 +6,7 @@
 #include <assimp/scene.h>
 #include <learnopengl/bone.h>
 #include <functional>
+#include <memory>
 #include <learnopengl/animdata.h>
 #include <learnopengl/model_animation.h>
 
@@ -17,30 +18,169 @@ struct AssimpNodeData
 	std::vector<AssimpNodeData> children;
 };
 
+/*
+	Node hierarchy flattened once per skeleton, so that the pose is evaluated by a
+	linear loop without any string lookup. Nodes are in depth first order: a parent
+	always comes before its children. All arrays are indexed by node.
+*/
+struct CompiledSkeleton
+{
+	std::vector<std::string> names;
+	std::vector<int> parentIndices;        // -1 for the root
+	std::vector<int> boneIds;              // index in the final bone matrices, -1 if no vertex is skinned to the node
+	std::vector<glm::mat4> bindTransforms; // local transformation used when the node is not animated
+	std::vector<glm::mat4> offsets;        // bone offset matrices (identity if boneIds is -1)
+	std::vector<int> unlinkedBoneIds;      // bone ids without a node, their matrix is the identity
+	std::vector<int> heights;              // levels of descendants below the node: 0 for a leaf (fingers, toes...)
+
+	int GetNodeCount() const { return static_cast<int>(parentIndices.size()); }
+};
+
+/*
+	Node hierarchy and bone ids of a model, shared by all the clips played on it.
+	The bone ids must cover every channel of these clips (see Create).
+*/
+struct AnimationSkeleton
+{
+	AssimpNodeData root;                         // node tree, for the reference evaluation
+	std::map<std::string, BoneInfo> boneInfoMap; // bone name to id and offset
+	CompiledSkeleton compiled;
+
+	static std::shared_ptr<AnimationSkeleton> Create(const AssimpNodeData& root, const std::map<std::string, BoneInfo>& boneInfoMap)
+	{
+		std::shared_ptr<AnimationSkeleton> skeleton = std::make_shared<AnimationSkeleton>();
+		skeleton->root = root;
+		skeleton->boneInfoMap = boneInfoMap;
+		skeleton->CompileNode(root, -1);
+
+		// children come after their parent, so a reverse pass sees every child before its parent
+		CompiledSkeleton& compiled = skeleton->compiled;
+		compiled.heights.assign(compiled.GetNodeCount(), 0);
+		for (int i = compiled.GetNodeCount() - 1; i > 0; --i)
+		{
+			const int parent = compiled.parentIndices[i];
+			compiled.heights[parent] = std::max(compiled.heights[parent], compiled.heights[i] + 1);
+		}
+
+		const std::vector<int>& boneIds = skeleton->compiled.boneIds;
+		for (const auto& boneInfo : boneInfoMap)
+		{
+			if (std::find(boneIds.begin(), boneIds.end(), boneInfo.second.id) == boneIds.end())
+				skeleton->compiled.unlinkedBoneIds.push_back(boneInfo.second.id);
+		}
+		return skeleton;
+	}
+
+	// skeleton of an imported scene: the channels of all its animations are added to the bones of the model
+	static std::shared_ptr<AnimationSkeleton> Import(const aiScene* scene, Model& model)
+	{
+		auto& boneInfoMap = model.GetOffsetMatMap();
+		int& boneCount = model.GetBoneCount();
+		for (unsigned int i = 0; i < scene->mNumAnimations; ++i)
+		{
+			const aiAnimation* animation = scene->mAnimations[i];
+			for (unsigned int channel = 0; channel < animation->mNumChannels; ++channel)
+			{
+				std::string boneName = animation->mChannels[channel]->mNodeName.data;
+				if (boneInfoMap.find(boneName) == boneInfoMap.end())
+				{
+					boneInfoMap[boneName].id = boneCount;
+					boneCount++;
+				}
+			}
+		}
+
+		AssimpNodeData root;
+		ReadHeirarchyData(root, scene->mRootNode);
+		return Create(root, boneInfoMap);
+	}
+
+	static void ReadHeirarchyData(AssimpNodeData& dest, const aiNode* src)
+	{
+		assert(src);
+
+		dest.name = src->mName.data;
+		dest.transformation = AssimpGLMHelpers::ConvertMatrixToGLMFormat(src->mTransformation);
+		dest.childrenCount = src->mNumChildren;
+
+		for (int i = 0; i < src->mNumChildren; i++)
+		{
+			AssimpNodeData newData;
+			ReadHeirarchyData(newData, src->mChildren[i]);
+			dest.children.push_back(newData);
+		}
+	}
+
+private:
+	void CompileNode(const AssimpNodeData& node, int parentIndex)
+	{
+		const int nodeIndex = compiled.GetNodeCount();
+
+		auto boneInfo = boneInfoMap.find(node.name);
+		compiled.names.push_back(node.name);
+		compiled.parentIndices.push_back(parentIndex);
+		compiled.boneIds.push_back(boneInfo != boneInfoMap.end() ? boneInfo->second.id : -1);
+		compiled.bindTransforms.push_back(node.transformation);
+		compiled.offsets.push_back(boneInfo != boneInfoMap.end() ? boneInfo->second.offset : glm::mat4(1.0f));
+
+		for (const AssimpNodeData& child : node.children)
+			CompileNode(child, nodeIndex);
+	}
+};
+
+struct AnimationCompressionReport
+{
+	int keysBefore = 0;
+	int keysAfter = 0;
+	size_t bytesBefore = 0;
+	size_t bytesAfter = 0;
+};
+
+/*
+	Clip data: read only once loaded. The playback state (time, key cursors, pose)
+	lives in the Animator, so one Animation can be shared by any number of animators
+	updated concurrently. The skeleton is shared by all the clips of a model.
+*/
 class Animation
 {
 public:
 	Animation() = default;
 
+	// imports the file again for its first clip, see AnimationLibrary to load the model and all its clips at once
 	Animation(const std::string& animationPath, Model* model)
 	{
 		Assimp::Importer importer;
 		const aiScene* scene = importer.ReadFile(animationPath, aiProcess_Triangulate);
 		assert(scene && scene->mRootNode);
-		auto animation = scene->mAnimations[0];
+		*this = Animation(scene->mAnimations[0], AnimationSkeleton::Import(scene, *model));
+	}
+
+	Animation(const aiAnimation* animation, std::shared_ptr<const AnimationSkeleton> skeleton)
+	{
+		m_Name = animation->mName.data;
 		m_Duration = animation->mDuration;
 		m_TicksPerSecond = animation->mTicksPerSecond;
-		aiMatrix4x4 globalTransformation = scene->mRootNode->mTransformation;
-		globalTransformation = globalTransformation.Inverse();
-		ReadHeirarchyData(m_RootNode, scene->mRootNode);
-		SetupBones(animation, *model);
+		m_Skeleton = skeleton;
+		for (unsigned int i = 0; i < animation->mNumChannels; i++)
+		{
+			auto channel = animation->mChannels[i];
+			m_Bones.push_back(Bone(channel->mNodeName.data,
+				skeleton->boneInfoMap.at(channel->mNodeName.data).id, channel));
+		}
+		LinkChannels();
+	}
+
+	Animation(const std::string& name, float duration, int ticksPerSecond, std::vector<Bone> bones, std::shared_ptr<const AnimationSkeleton> skeleton)
+		: m_Name(name), m_Duration(duration), m_TicksPerSecond(ticksPerSecond), m_Bones(std::move(bones)), m_Skeleton(skeleton)
+	{
+		LinkChannels();
 	}
 
 	~Animation()
 	{
 	}
 
-	Bone* FindBone(const std::string& name)
+	const Bone* FindBone(const std::string& name) const
 	{
 		auto iter = std::find_if(m_Bones.begin(), m_Bones.end(),
 			[&](const Bone& Bone)
@@ -53,58 +193,97 @@ public:
 	}
 
 	
-	inline float GetTicksPerSecond() { return m_TicksPerSecond; }
-	inline float GetDuration() { return m_Duration;}
-	inline const AssimpNodeData& GetRootNode() { return m_RootNode; }
-	inline const std::map<std::string,BoneInfo>& GetBoneIDMap() 
+	inline const std::string& GetName() const { return m_Name; }
+	inline float GetTicksPerSecond() const { return m_TicksPerSecond; }
+	inline float GetDuration() const { return m_Duration;}
+	inline const AssimpNodeData& GetRootNode() const { return m_Skeleton->root; }
+	inline const std::map<std::string,BoneInfo>& GetBoneIDMap() const
 	{ 
-		return m_BoneInfoMap;
+		return m_Skeleton->boneInfoMap;
 	}
+	inline const CompiledSkeleton& GetSkeleton() const { return m_Skeleton->compiled; }
+	inline const std::shared_ptr<const AnimationSkeleton>& GetSharedSkeleton() const { return m_Skeleton; }
+	inline const std::vector<Bone>& GetBones() const { return m_Bones; }
 
-private:
-	void SetupBones(const aiAnimation* animation, Model& model)
+	// compresses the keys of every bone (see Bone::Compress), at load time before the clip is played
+	AnimationCompressionReport Compress(const BoneCompressionSettings& settings = BoneCompressionSettings())
 	{
-		int size = animation->mNumChannels;
+		AnimationCompressionReport report;
+		for (Bone& bone : m_Bones)
+		{
+			report.keysBefore += bone.GetKeyCount();
+			report.bytesBefore += bone.GetMemorySize();
+			bone.Compress(settings);
+			report.keysAfter += bone.GetKeyCount();
+			report.bytesAfter += bone.GetMemorySize();
+		}
+		return report;
+	}
 
-		auto& boneInfoMap = model.GetOffsetMatMap();
-		int& boneCount = model.GetBoneCount();
+	// evaluates the pose with the compiled skeleton: one linear pass, parents before children. The playback state
+	// belongs to the caller: one cursor per bone and one global transform per node, resized as needed.
+	// pose is only written, every bone id gets exactly one matrix so it may point to write combined memory.
+	// The nodes less than skippedLevels levels above a leaf keep their bind transform instead of sampling their
+	// channel (level of detail of distant characters). Returns the number of channels sampled.
+	int EvaluatePose(float animationTime, std::vector<BoneCursor>& cursors, std::vector<glm::mat4>& globalTransforms, glm::mat4* pose, int skippedLevels = 0) const
+	{
+		const CompiledSkeleton& skeleton = m_Skeleton->compiled;
+		const int nodeCount = skeleton.GetNodeCount();
+		globalTransforms.resize(nodeCount);
+		cursors.resize(m_Bones.size());
 
-		for (int i = 0; i < size; i++)
+		int sampledChannels = 0;
+		for (int i = 0; i < nodeCount; ++i)
 		{
-			auto channel = animation->mChannels[i];
-			std::string boneName = channel->mNodeName.data;
-
-			if (boneInfoMap.find(boneName) == boneInfoMap.end())
+			const int channel = m_NodeChannels[i];
+			glm::mat4 nodeTransform;
+			if (channel >= 0 && skeleton.heights[i] >= skippedLevels)
 			{
-				boneInfoMap[boneName].id = boneCount;
-				boneCount++;
+				nodeTransform = m_Bones[channel].Evaluate(animationTime, cursors[channel]);
+				sampledChannels++;
 			}
-			m_Bones.push_back(Bone(channel->mNodeName.data,
-				boneInfoMap[channel->mNodeName.data].id, channel));
+			else
+			{
+				nodeTransform = skeleton.bindTransforms[i];
+			}
+
+			const int parent = skeleton.parentIndices[i];
+			globalTransforms[i] = parent >= 0 ? globalTransforms[parent] * nodeTransform : nodeTransform;
+
+			const int boneId = skeleton.boneIds[i];
+			if (boneId >= 0)
+				pose[boneId] = globalTransforms[i] * skeleton.offsets[i];
 		}
 
-		m_BoneInfoMap = boneInfoMap;
+		for (int boneId : skeleton.unlinkedBoneIds)
+			pose[boneId] = glm::mat4(1.0f);
+		return sampledChannels;
 	}
 
-	void ReadHeirarchyData(AssimpNodeData& dest, const aiNode* src)
-	{
-		assert(src);
-
-		dest.name = src->mName.data;
-		dest.transformation = AssimpGLMHelpers::ConvertMatrixToGLMFormat(src->mTransformation);
-		dest.childrenCount = src->mNumChildren;
 
-		for (int i = 0; i < src->mNumChildren; i++)
+private:
+	// channel of every node of the skeleton, -1 if the clip doesn't animate it
+	void LinkChannels()
+	{
+		const CompiledSkeleton& skeleton = m_Skeleton->compiled;
+		m_NodeChannels.assign(skeleton.GetNodeCount(), -1);
+		for (int node = 0; node < skeleton.GetNodeCount(); ++node)
 		{
-			AssimpNodeData newData;
-			ReadHeirarchyData(newData, src->mChildren[i]);
-			dest.children.push_back(newData);
+			for (int i = 0; i < static_cast<int>(m_Bones.size()); ++i)
+			{
+				if (m_Bones[i].GetBoneName() == skeleton.names[node])
+				{
+					m_NodeChannels[node] = i;
+					break;
+				}
+			}
 		}
 	}
+
+	std::string m_Name;
 	float m_Duration;
 	int m_TicksPerSecond;
 	std::vector<Bone> m_Bones;
-	AssimpNodeData m_RootNode;
-	std::map<std::string, BoneInfo> m_BoneInfoMap;
+	std::shared_ptr<const AnimationSkeleton> m_Skeleton;
+	std::vector<int> m_NodeChannels; // per node of the skeleton
 };
-
@@ -0,0 +1,366 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <learnopengl/model_animation.h>
+#include <learnopengl/animation.h>
+#include <learnopengl/bone_palette.h>
+
+const uint32_t ANIMATION_CACHE_MAGIC = 0x4d494e41; // "ANIM"
+const uint32_t ANIMATION_CACHE_VERSION = 2;
+
+/*
+	A skinned model and all its animation clips, loaded with a single import of the
+	file and keyed by clip name. The clips share one AnimationSkeleton.
+
+	After an import the meshes, bones, node tree and clips are written to a binary
+	cache; the next loads read the cache instead of going through Assimp, as long as
+	the source file keeps the same size and content hash. The cache is a raw dump for
+	the machine that wrote it (native endianness and struct layout), not an interchange
+	format. A cache that is truncated or whose counts, indices or bone ids are out of
+	range is ignored and the source file imported again.
+*/
+class AnimationLibrary
+{
+public:
+	// returns false if neither the cache nor the source file could be loaded. An empty cachePath disables the cache.
+	bool Load(const std::string& path, Model& model, const std::string& cachePath = "")
+	{
+		m_Clips.clear();
+		m_ClipNames.clear();
+		m_Skeleton.reset();
+		m_LoadedFromCache = false;
+
+		const int64_t sourceSize = GetFileSize(path);
+		const uint64_t sourceHash = cachePath.empty() ? 0 : HashFile(path);
+		if (!cachePath.empty() && ReadCache(cachePath, path, sourceSize, sourceHash, model))
+		{
+			m_LoadedFromCache = true;
+			return true;
+		}
+
+		Assimp::Importer importer;
+		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace);
+		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+		{
+			std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+			return false;
+		}
+
+		model.loadScene(scene, path);
+		m_Skeleton = AnimationSkeleton::Import(scene, model);
+		for (unsigned int i = 0; i < scene->mNumAnimations; ++i)
+			AddClip(Animation(scene->mAnimations[i], m_Skeleton), i);
+
+		if (!cachePath.empty())
+			WriteCache(cachePath, sourceSize, sourceHash, model);
+		return true;
+	}
+
+	Animation* GetClip(const std::string& name)
+	{
+		auto clip = m_Clips.find(name);
+		return clip != m_Clips.end() ? &clip->second : nullptr;
+	}
+
+	// clips in the order of the file
+	Animation* GetClip(size_t index)
+	{
+		return index < m_ClipNames.size() ? GetClip(m_ClipNames[index]) : nullptr;
+	}
+
+	size_t GetClipCount() const { return m_ClipNames.size(); }
+	const std::vector<std::string>& GetClipNames() const { return m_ClipNames; }
+	const std::shared_ptr<const AnimationSkeleton>& GetSkeleton() const { return m_Skeleton; }
+	bool WasLoadedFromCache() const { return m_LoadedFromCache; }
+
+private:
+	// unnamed clips are called clip<index>, duplicated names get their index appended
+	void AddClip(Animation clip, unsigned int index)
+	{
+		std::string name = clip.GetName().empty() ? "clip" + std::to_string(index) : clip.GetName();
+		if (m_Clips.count(name))
+			name += "#" + std::to_string(index);
+		m_ClipNames.push_back(name);
+		m_Clips.insert(std::make_pair(name, std::move(clip)));
+	}
+
+	static int64_t GetFileSize(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		return file ? static_cast<int64_t>(file.tellg()) : -1;
+	}
+
+	// FNV-1a of the content: a source re-exported with the same size still invalidates the cache
+	static uint64_t HashFile(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		uint64_t hash = 14695981039346656037ull;
+		char buffer[65536];
+		while (file)
+		{
+			file.read(buffer, sizeof(buffer));
+			for (std::streamsize i = 0; i < file.gcount(); ++i)
+				hash = (hash ^ static_cast<unsigned char>(buffer[i])) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// true if at least bytes are left in the stream: counts read from a corrupted cache must not size allocations
+	static bool CanRead(std::istream& in, uint64_t bytes)
+	{
+		const std::streampos position = in.tellg();
+		if (position < 0)
+			return false;
+		in.seekg(0, std::ios::end);
+		const std::streampos end = in.tellg();
+		in.seekg(position);
+		return end >= position && bytes <= static_cast<uint64_t>(end - position);
+	}
+
+	// raw values and arrays
+	template<typename T>
+	static void Write(std::ostream& out, const T& value)
+	{
+		out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	static void WriteVector(std::ostream& out, const std::vector<T>& values)
+	{
+		Write(out, static_cast<uint32_t>(values.size()));
+		if (!values.empty())
+			out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+	}
+
+	static void WriteString(std::ostream& out, const std::string& value)
+	{
+		Write(out, static_cast<uint32_t>(value.size()));
+		out.write(value.data(), value.size());
+	}
+
+	template<typename T>
+	static bool Read(std::istream& in, T& value)
+	{
+		return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	template<typename T>
+	static bool ReadVector(std::istream& in, std::vector<T>& values)
+	{
+		uint32_t size = 0;
+		if (!Read(in, size) || !CanRead(in, static_cast<uint64_t>(size) * sizeof(T)))
+			return false;
+		values.resize(size);
+		return size == 0 || static_cast<bool>(in.read(reinterpret_cast<char*>(values.data()), size * sizeof(T)));
+	}
+
+	static bool ReadString(std::istream& in, std::string& value)
+	{
+		uint32_t size = 0;
+		if (!Read(in, size) || !CanRead(in, size))
+			return false;
+		value.resize(size);
+		return size == 0 || static_cast<bool>(in.read(&value[0], size));
+	}
+
+	static void WriteNode(std::ostream& out, const AssimpNodeData& node)
+	{
+		WriteString(out, node.name);
+		Write(out, node.transformation);
+		Write(out, static_cast<uint32_t>(node.children.size()));
+		for (const AssimpNodeData& child : node.children)
+			WriteNode(out, child);
+	}
+
+	static bool ReadNode(std::istream& in, AssimpNodeData& node)
+	{
+		uint32_t childrenCount = 0;
+		if (!ReadString(in, node.name) || !Read(in, node.transformation) || !Read(in, childrenCount) || !CanRead(in, childrenCount))
+			return false;
+		node.childrenCount = childrenCount;
+		node.children.resize(childrenCount);
+		for (AssimpNodeData& child : node.children)
+			if (!ReadNode(in, child))
+				return false;
+		return true;
+	}
+
+	void WriteCache(const std::string& cachePath, int64_t sourceSize, uint64_t sourceHash, Model& model) const
+	{
+		std::ofstream out(cachePath, std::ios::binary);
+		if (!out)
+			return;
+
+		Write(out, ANIMATION_CACHE_MAGIC);
+		Write(out, ANIMATION_CACHE_VERSION);
+		Write(out, sourceSize);
+		Write(out, sourceHash);
+
+		// meshes
+		Write(out, static_cast<uint32_t>(model.meshes.size()));
+		for (const Mesh& mesh : model.meshes)
+		{
+			WriteVector(out, mesh.vertices);
+			WriteVector(out, mesh.indices);
+			Write(out, static_cast<uint32_t>(mesh.textures.size()));
+			for (const Texture& texture : mesh.textures)
+			{
+				WriteString(out, texture.type);
+				WriteString(out, texture.path);
+			}
+		}
+
+		// bones (including the channels added by the clips) and node tree
+		Write(out, static_cast<int32_t>(model.GetBoneCount()));
+		Write(out, static_cast<uint32_t>(m_Skeleton->boneInfoMap.size()));
+		for (const auto& boneInfo : m_Skeleton->boneInfoMap)
+		{
+			WriteString(out, boneInfo.first);
+			Write(out, static_cast<int32_t>(boneInfo.second.id));
+			Write(out, boneInfo.second.offset);
+		}
+		WriteNode(out, m_Skeleton->root);
+
+		// clips
+		Write(out, static_cast<uint32_t>(m_ClipNames.size()));
+		for (const std::string& name : m_ClipNames)
+		{
+			const Animation& clip = m_Clips.at(name);
+			WriteString(out, clip.GetName());
+			Write(out, clip.GetDuration());
+			Write(out, static_cast<int32_t>(clip.GetTicksPerSecond()));
+			Write(out, static_cast<uint32_t>(clip.GetBones().size()));
+			for (const Bone& bone : clip.GetBones())
+			{
+				WriteString(out, bone.GetBoneName());
+				Write(out, static_cast<int32_t>(bone.GetBoneID()));
+				WriteVector(out, bone.GetPositionKeys());
+				WriteVector(out, bone.GetRotationKeys());
+				WriteVector(out, bone.GetScaleKeys());
+			}
+		}
+	}
+
+	// the cache is used when it was written by this version for a source file of the same size and hash (or without source)
+	bool ReadCache(const std::string& cachePath, const std::string& path, int64_t sourceSize, uint64_t sourceHash, Model& model)
+	{
+		std::ifstream in(cachePath, std::ios::binary);
+		uint32_t magic = 0, version = 0;
+		int64_t cachedSourceSize = 0;
+		uint64_t cachedSourceHash = 0;
+		if (!in || !Read(in, magic) || !Read(in, version) || !Read(in, cachedSourceSize) || !Read(in, cachedSourceHash))
+			return false;
+		if (magic != ANIMATION_CACHE_MAGIC || version != ANIMATION_CACHE_VERSION || (sourceSize >= 0 && (cachedSourceSize != sourceSize || cachedSourceHash != sourceHash)))
+			return false;
+
+		// meshes, kept aside until the whole file is read so that a truncated cache doesn't leave a partial model
+		struct MeshData
+		{
+			std::vector<Vertex> vertices;
+			std::vector<unsigned int> indices;
+			std::vector<std::pair<std::string, std::string>> textures; // type, path
+		};
+		uint32_t meshCount = 0;
+		if (!Read(in, meshCount) || !CanRead(in, meshCount))
+			return false;
+		std::vector<MeshData> meshes(meshCount);
+		for (MeshData& mesh : meshes)
+		{
+			uint32_t textureCount = 0;
+			if (!ReadVector(in, mesh.vertices) || !ReadVector(in, mesh.indices) || !Read(in, textureCount) || !CanRead(in, textureCount))
+				return false;
+			for (unsigned int index : mesh.indices)
+				if (index >= mesh.vertices.size())
+					return false;
+			mesh.textures.resize(textureCount);
+			for (auto& texture : mesh.textures)
+				if (!ReadString(in, texture.first) || !ReadString(in, texture.second))
+					return false;
+		}
+
+		int32_t boneCount = 0;
+		uint32_t boneInfoCount = 0;
+		if (!Read(in, boneCount) || !Read(in, boneInfoCount) || boneCount < 0 || boneCount > MAX_BONES || !CanRead(in, boneInfoCount))
+			return false;
+		// bone ids index the palettes: -1 (no bone) or below boneCount
+		for (const MeshData& mesh : meshes)
+			for (const Vertex& vertex : mesh.vertices)
+				for (int i = 0; i < MAX_BONE_WEIGHTS; ++i)
+					if (vertex.m_BoneIDs[i] < -1 || vertex.m_BoneIDs[i] >= boneCount)
+						return false;
+		std::map<std::string, BoneInfo> boneInfoMap;
+		for (uint32_t i = 0; i < boneInfoCount; ++i)
+		{
+			std::string name;
+			int32_t id = 0;
+			BoneInfo info;
+			if (!ReadString(in, name) || !Read(in, id) || !Read(in, info.offset) || id < 0 || id >= boneCount)
+				return false;
+			info.id = id;
+			boneInfoMap[name] = info;
+		}
+		AssimpNodeData root;
+		if (!ReadNode(in, root))
+			return false;
+		std::shared_ptr<const AnimationSkeleton> skeleton = AnimationSkeleton::Create(root, boneInfoMap);
+
+		uint32_t clipCount = 0;
+		if (!Read(in, clipCount) || !CanRead(in, clipCount))
+			return false;
+		std::vector<Animation> clips;
+		for (uint32_t i = 0; i < clipCount; ++i)
+		{
+			std::string name;
+			float duration = 0.0f;
+			int32_t ticksPerSecond = 0;
+			uint32_t channelCount = 0;
+			if (!ReadString(in, name) || !Read(in, duration) || !Read(in, ticksPerSecond) || !Read(in, channelCount) || !CanRead(in, channelCount))
+				return false;
+			std::vector<Bone> bones;
+			for (uint32_t channel = 0; channel < channelCount; ++channel)
+			{
+				std::string boneName;
+				int32_t id = 0;
+				std::vector<KeyPosition> positions;
+				std::vector<KeyRotation> rotations;
+				std::vector<KeyScale> scales;
+				if (!ReadString(in, boneName) || !Read(in, id) || id < 0 || id >= boneCount || !ReadVector(in, positions) || !ReadVector(in, rotations) || !ReadVector(in, scales))
+					return false;
+				bones.push_back(Bone(boneName, id, std::move(positions), std::move(rotations), std::move(scales)));
+			}
+			clips.push_back(Animation(name, duration, ticksPerSecond, std::move(bones), skeleton));
+		}
+
+		// everything was read: build the model, its textures are loaded from the directory of the source file
+		model.directory = path.substr(0, path.find_last_of('/'));
+		for (MeshData& mesh : meshes)
+		{
+			std::vector<Texture> textures;
+			for (const auto& texture : mesh.textures)
+				textures.push_back(model.loadTexture(texture.second, texture.first));
+			model.meshes.push_back(Mesh(mesh.vertices, mesh.indices, textures));
+		}
+		model.GetOffsetMatMap() = boneInfoMap;
+		model.GetBoneCount() = boneCount;
+
+		m_Skeleton = skeleton;
+		for (uint32_t i = 0; i < clipCount; ++i)
+			AddClip(std::move(clips[i]), i);
+		return true;
+	}
+
+	std::map<std::string, Animation> m_Clips;
+	std::vector<std::string> m_ClipNames;
+	std::shared_ptr<const AnimationSkeleton> m_Skeleton;
+	bool m_LoadedFromCache = false;
+};
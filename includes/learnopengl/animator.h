@@ -3,52 +3,217 @@
 #include <glm/glm.hpp>
 #include <map>
 #include <vector>
+#include <cmath>
+#include <algorithm>
 #include <assimp/scene.h>
 #include <assimp/Importer.hpp>
 #include <learnopengl/animation.h>
 #include <learnopengl/bone.h>
+#include <learnopengl/bone_palette.h>
+#include <learnopengl/dual_quaternion.h>
+#include <learnopengl/pose_cache.h>
 
+// level of detail of the next updates of one character, chosen by the application (see SelectAnimationLOD)
+struct AnimationLOD
+{
+	int updateInterval = 1;    // frames between two evaluations of the pose, the frames in between blend the evaluated poses
+	int skippedBoneLevels = 0; // bones this number of levels above a leaf or less keep their bind pose (see Animation::EvaluatePose)
+	bool frozen = false;       // off-screen: the time goes on but the pose isn't evaluated
+};
+
+// screen sizes are the height of the character over the height of the viewport
+struct AnimationLODSettings
+{
+	float fullRateScreenSize = 0.2f;  // evaluated every frame above this size
+	float halfRateScreenSize = 0.08f; // every 2 frames above this size, every maxUpdateInterval frames below
+	int maxUpdateInterval = 4;
+	float leafBoneScreenSize = 0.1f;  // leaf bones skipped below this size, and their parents below half of it
+};
+
+inline AnimationLOD SelectAnimationLOD(float screenSize, bool visible, const AnimationLODSettings& settings = AnimationLODSettings())
+{
+	AnimationLOD lod;
+	lod.frozen = !visible;
+	lod.updateInterval = screenSize >= settings.fullRateScreenSize ? 1 : screenSize >= settings.halfRateScreenSize ? 2 : settings.maxUpdateInterval;
+	lod.skippedBoneLevels = screenSize >= settings.leafBoneScreenSize ? 0 : screenSize >= settings.leafBoneScreenSize * 0.5f ? 1 : 2;
+	return lod;
+}
+
+// channels of the clip sampled or skipped by the updates, per character or summed over a frame
+struct AnimationLODStats
+{
+	int evaluatedBones = 0;
+	int skippedBones = 0;
+	int interpolatedCharacters = 0; // characters whose pose was blended from poses evaluated on other frames
+	int frozenCharacters = 0;
+
+	AnimationLODStats& operator+=(const AnimationLODStats& other)
+	{
+		evaluatedBones += other.evaluatedBones;
+		skippedBones += other.skippedBones;
+		interpolatedCharacters += other.interpolatedCharacters;
+		frozenCharacters += other.frozenCharacters;
+		return *this;
+	}
+};
+
+// playback state of one character: the animation it plays is only read, so animators sharing it can be updated in parallel
 class Animator
 {	
 public:
-	Animator::Animator(Animation* current)
+	Animator(Animation* current)
 	{
 		m_CurrentAnimation = current;
 		m_CurrentTime = 0.0;
-		m_Transforms.reserve(100);
-		for (int i = 0; i < 100; i++)
+		m_Transforms.reserve(MAX_BONES);
+		for (int i = 0; i < MAX_BONES; i++)
 			m_Transforms.push_back(glm::mat4(1.0f));
+		ResetCursors();
+	}
+
+	void UpdateAnimation(float dt)
+	{
+		UpdateAnimation(dt, m_Transforms.data());
 	}
 
-	void Animator::UpdateAnimation(float dt)
+	// writes the pose straight into pose (MAX_BONES matrices, e.g. a palette of a mapped BonePaletteBuffer)
+	// instead of the transforms of the animator
+	// With a reduced update rate the animator evaluates the pose updateInterval frames ahead and blends toward it
+	// on the frames in between; frozen characters repeat their last pose.
+	void UpdateAnimation(float dt, glm::mat4* pose)
+	{
+		AdvanceTime(dt);
+		if (!m_CurrentAnimation)
+			return;
+
+		int sampledChannels = 0;
+		if (m_LOD.frozen)
+		{
+			if (!m_HasKeyframes)
+			{
+				sampledChannels += EvaluatePose(m_CurrentTime, m_Keyframes[1].data());
+				m_Keyframes[0] = m_Keyframes[1];
+				m_BlendFrame = m_BlendFrames = 1;
+				m_HasKeyframes = true;
+			}
+			BlendKeyframes(pose);
+			m_LODStats.frozenCharacters = 1;
+		}
+		else if (m_LOD.updateInterval <= 1)
+		{
+			m_HasKeyframes = false;
+			sampledChannels += EvaluatePose(m_CurrentTime, pose);
+		}
+		else
+		{
+			// the keyframes of a freeze are too old to blend from
+			if (m_WasFrozen)
+				m_HasKeyframes = false;
+			if (!m_HasKeyframes || m_BlendFrame >= m_BlendFrames)
+				sampledChannels += StartBlend();
+			else
+				m_LODStats.interpolatedCharacters = 1;
+			BlendKeyframes(pose);
+			m_BlendFrame++;
+		}
+		m_WasFrozen = m_LOD.frozen;
+
+		m_LODStats.evaluatedBones = sampledChannels;
+		m_LODStats.skippedBones = std::max(0, static_cast<int>(m_CurrentAnimation->GetBones().size()) - sampledChannels);
+	}
+
+	// moves the playback time forward without evaluating any pose (when the pose is shared, see PoseSharing)
+	void AdvanceTime(float dt)
 	{
 		m_DeltaTime = dt;
+		m_LODStats = AnimationLODStats();
 		if (m_CurrentAnimation)
 		{
 			m_CurrentTime += m_CurrentAnimation->GetTicksPerSecond() * dt;
 			m_CurrentTime = fmod(m_CurrentTime, m_CurrentAnimation->GetDuration());
-			CalculateBoneTransform(&m_CurrentAnimation->GetRootNode(), glm::mat4(1.0f));
 		}
 	}
 
-	void Animator::PlayAnimation(Animation* pAnimation)
+	// dual quaternion palette (e.g. of a BonePaletteBuffer in BONE_PALETTE_DUAL_QUATERNIONS format): the pose is
+	// evaluated in the transforms of the animator, then converted for the bone ids of the clip
+	void UpdateAnimation(float dt, BoneDualQuaternion* pose)
+	{
+		UpdateAnimation(dt, m_Transforms.data());
+		ToDualQuaternions(m_Transforms.data(), m_BoneCount, pose);
+	}
+
+	void PlayAnimation(Animation* pAnimation)
 	{
 		m_CurrentAnimation = pAnimation;
 		m_CurrentTime = 0.0f;
+		ResetCursors();
+		m_HasKeyframes = false;
+		if (m_PoseCache && m_PoseCache->GetAnimation() != pAnimation)
+			m_PoseCache = nullptr;
+	}
+
+	// cached mode: the pose is blended from the samples of cache (baked from the current animation),
+	// nullptr goes back to the live evaluation of the keyframes
+	void SetPoseCache(const PoseCache* cache)
+	{
+		m_PoseCache = cache && cache->GetAnimation() == m_CurrentAnimation ? cache : nullptr;
+	}
+	const PoseCache* GetPoseCache() const { return m_PoseCache; }
+
+	void CalculateBoneTransforms()
+	{
+		CalculateBoneTransforms(m_Transforms.data());
+	}
+
+	// evaluates the pose with the compiled skeleton of the animation, or blends the baked samples in cached mode.
+	// pose is only written, every bone id gets exactly one matrix so it may point to write combined memory.
+	void CalculateBoneTransforms(glm::mat4* pose)
+	{
+		EvaluatePose(m_CurrentTime, pose);
 	}
 
-	void Animator::CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform)
+	void CalculateBoneTransforms(BoneDualQuaternion* pose)
+	{
+		CalculateBoneTransforms(pose, m_LOD.skippedBoneLevels);
+	}
+
+	// same with skippedBoneLevels instead of the one of the level of detail, 0 evaluates every bone (for poses shared by several characters)
+	void CalculateBoneTransforms(glm::mat4* pose, int skippedBoneLevels)
+	{
+		EvaluatePose(m_CurrentTime, pose, skippedBoneLevels);
+	}
+
+	void CalculateBoneTransforms(BoneDualQuaternion* pose, int skippedBoneLevels)
+	{
+		EvaluatePose(m_CurrentTime, m_Transforms.data(), skippedBoneLevels);
+		ToDualQuaternions(m_Transforms.data(), m_BoneCount, pose);
+	}
+
+	// level of detail of the next updates, see SelectAnimationLOD
+	void SetLOD(const AnimationLOD& lod) { m_LOD = lod; }
+	const AnimationLOD& GetLOD() const { return m_LOD; }
+
+	// characters with reduced update rates evaluate on the frames where (frame + phase) is a multiple of their interval:
+	// give them different phases (their index for example) to spread the evaluations over the frames
+	void SetUpdatePhase(int phase)
+	{
+		m_UpdatePhase = std::max(0, phase);
+		m_HasKeyframes = false;
+	}
+
+	// channels sampled and skipped by the last update
+	const AnimationLODStats& GetLODStats() const { return m_LODStats; }
+
+	// reference evaluation walking the node tree with name lookups, kept to validate and benchmark the compiled skeleton
+	void CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform)
 	{
 		std::string nodeName = node->name;
 		glm::mat4 nodeTransform = node->transformation;
 
-		Bone* Bone = m_CurrentAnimation->FindBone(nodeName);
+		const Bone* Bone = m_CurrentAnimation->FindBone(nodeName);
 
 		if (Bone)
-		{
-			Bone->Update(m_CurrentTime);
-			nodeTransform = Bone->GetLocalTransform();
-		}
+			nodeTransform = Bone->Evaluate(m_CurrentTime, m_Cursors[Bone - m_CurrentAnimation->GetBones().data()]);
 
 		glm::mat4 globalTransformation = parentTransform * nodeTransform;
 
@@ -64,13 +229,89 @@ public:
 			CalculateBoneTransform(&node->children[i], globalTransformation);
 	}
 
-	std::vector<glm::mat4> GetPoseTransforms() 
+	const std::vector<glm::mat4>& GetPoseTransforms() const
 	{ 
 		return m_Transforms;  
 	}
+
+	void SetCurrentTime(float time) { m_CurrentTime = time; }
+	float GetCurrentTime() const { return m_CurrentTime; }
+	Animation* GetCurrentAnimation() const { return m_CurrentAnimation; }
 	
 private:
+	void ResetCursors()
+	{
+		m_Cursors.assign(m_CurrentAnimation ? m_CurrentAnimation->GetBones().size() : 0, BoneCursor());
+
+		// the keyframes only hold the bone ids of the clip, palettes may be packed without room for MAX_BONES
+		m_BoneCount = 0;
+		if (m_CurrentAnimation)
+			for (const auto& boneInfo : m_CurrentAnimation->GetBoneIDMap())
+				m_BoneCount = std::max(m_BoneCount, boneInfo.second.id + 1);
+		m_Keyframes[0].assign(m_BoneCount, glm::mat4(1.0f));
+		m_Keyframes[1].assign(m_BoneCount, glm::mat4(1.0f));
+	}
+
+	// returns the number of channels sampled, all of them when the pose comes from the cache
+	int EvaluatePose(float time, glm::mat4* pose)
+	{
+		return EvaluatePose(time, pose, m_LOD.skippedBoneLevels);
+	}
+
+	int EvaluatePose(float time, glm::mat4* pose, int skippedBoneLevels)
+	{
+		if (m_PoseCache)
+		{
+			m_PoseCache->Sample(time, pose);
+			return static_cast<int>(m_CurrentAnimation->GetBones().size());
+		}
+		return m_CurrentAnimation->EvaluatePose(time, m_Cursors, m_GlobalTransforms, pose, skippedBoneLevels);
+	}
+
+	// the pose of the current time becomes the first keyframe, the second one is evaluated at the end of the blend
+	int StartBlend()
+	{
+		int sampledChannels = 0;
+		int frames = m_LOD.updateInterval;
+		if (!m_HasKeyframes)
+		{
+			sampledChannels += EvaluatePose(m_CurrentTime, m_Keyframes[1].data());
+			frames -= m_UpdatePhase % frames; // aligns the next evaluations on the phase
+		}
+		std::swap(m_Keyframes[0], m_Keyframes[1]);
+
+		const float endTime = fmod(m_CurrentTime + m_CurrentAnimation->GetTicksPerSecond() * m_DeltaTime * frames, m_CurrentAnimation->GetDuration());
+		sampledChannels += EvaluatePose(endTime, m_Keyframes[1].data());
+		m_BlendFrame = 0;
+		m_BlendFrames = frames;
+		m_HasKeyframes = true;
+		return sampledChannels;
+	}
+
+	void BlendKeyframes(glm::mat4* pose) const
+	{
+		const float factor = std::min(1.0f, (float)m_BlendFrame / m_BlendFrames);
+		const glm::mat4* from = m_Keyframes[0].data();
+		const glm::mat4* to = m_Keyframes[1].data();
+		for (int bone = 0; bone < m_BoneCount; ++bone)
+			pose[bone] = from[bone] + (to[bone] - from[bone]) * factor;
+	}
+
 	std::vector<glm::mat4> m_Transforms;
+	std::vector<glm::mat4> m_GlobalTransforms; // per node of the compiled skeleton
+	std::vector<BoneCursor> m_Cursors;         // per bone (channel) of the current animation
+	const PoseCache* m_PoseCache = nullptr;
+
+	// level of detail: poses evaluated at the start and at the end of the current blend
+	AnimationLOD m_LOD;
+	AnimationLODStats m_LODStats;
+	std::vector<glm::mat4> m_Keyframes[2];
+	int m_BoneCount = 0;
+	int m_UpdatePhase = 0;
+	int m_BlendFrame = 0;
+	int m_BlendFrames = 1;
+	bool m_HasKeyframes = false;
+	bool m_WasFrozen = false;
 	Animation* m_CurrentAnimation;
 	float m_CurrentTime;
 	float m_DeltaTime;
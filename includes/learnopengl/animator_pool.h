@@ -0,0 +1,144 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <learnopengl/animator.h>
+#include <learnopengl/bone_palette.h>
+
+/*
+	Updates a batch of animators on persistent worker threads. The animators are
+	split in small chunks taken from a shared counter, so the threads stay busy even
+	when the skeletons differ in size, and the calling thread works on the batch too
+	before waiting for the others. Animators only read their Animation, so any
+	number of them may share the same clip.
+*/
+class AnimatorThreadPool
+{
+public:
+	// threadCount includes the calling thread, 0 uses every hardware thread
+	AnimatorThreadPool(unsigned int threadCount = 0)
+	{
+		if (threadCount == 0)
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		for (unsigned int i = 1; i < threadCount; ++i)
+			m_Workers.emplace_back(&AnimatorThreadPool::WorkerLoop, this);
+	}
+
+	~AnimatorThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Quit = true;
+		}
+		m_WakeUp.notify_all();
+		for (std::thread& worker : m_Workers)
+			worker.join();
+	}
+
+	AnimatorThreadPool(const AnimatorThreadPool&) = delete;
+	AnimatorThreadPool& operator=(const AnimatorThreadPool&) = delete;
+
+	// advances count animators by dt. With a mapped palette buffer, animator i writes its pose in palette i
+	// (as matrices or dual quaternions, after the format of the buffer). If the map failed the poses stay in the animators.
+	void UpdateAnimations(Animator* animators, int count, float dt, BonePaletteBuffer* palette = nullptr)
+	{
+		if (count <= 0)
+			return;
+		if (palette && !palette->IsMapped())
+			palette = nullptr;
+
+		// a single chunk is not worth waking up the workers
+		if (m_Workers.empty() || count <= CHUNK_SIZE)
+		{
+			for (int i = 0; i < count; ++i)
+				UpdateAnimator(animators[i], dt, palette, i);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Animators = animators;
+			m_Count = count;
+			m_DeltaTime = dt;
+			m_Palette = palette;
+			m_NextChunk = 0;
+			m_BusyWorkers = static_cast<int>(m_Workers.size());
+			++m_Batch;
+		}
+		m_WakeUp.notify_all();
+
+		ProcessChunks();
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Done.wait(lock, [this] { return m_BusyWorkers == 0; });
+	}
+
+	unsigned int GetThreadCount() const { return static_cast<unsigned int>(m_Workers.size()) + 1; }
+
+private:
+	static const int CHUNK_SIZE = 16;
+
+	void WorkerLoop()
+	{
+		unsigned int batch = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_WakeUp.wait(lock, [&] { return m_Quit || m_Batch != batch; });
+				if (m_Quit)
+					return;
+				batch = m_Batch;
+			}
+
+			ProcessChunks();
+
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (--m_BusyWorkers == 0)
+				m_Done.notify_one();
+		}
+	}
+
+	void ProcessChunks()
+	{
+		while (true)
+		{
+			const int begin = m_NextChunk.fetch_add(CHUNK_SIZE);
+			if (begin >= m_Count)
+				return;
+			const int end = std::min(begin + CHUNK_SIZE, m_Count);
+			for (int i = begin; i < end; ++i)
+				UpdateAnimator(m_Animators[i], m_DeltaTime, m_Palette, i);
+		}
+	}
+
+	// writes the pose in the format of the palette
+	static void UpdateAnimator(Animator& animator, float dt, BonePaletteBuffer* palette, int index)
+	{
+		if (!palette)
+			animator.UpdateAnimation(dt);
+		else if (palette->GetFormat() == BONE_PALETTE_DUAL_QUATERNIONS)
+			animator.UpdateAnimation(dt, palette->GetDualQuaternionPalette(index));
+		else
+			animator.UpdateAnimation(dt, palette->GetPalette(index));
+	}
+
+	std::vector<std::thread> m_Workers;
+	std::mutex m_Mutex;
+	std::condition_variable m_WakeUp;
+	std::condition_variable m_Done;
+	bool m_Quit = false;
+	unsigned int m_Batch = 0;
+	int m_BusyWorkers = 0;
+
+	// current batch, written under the mutex before the workers are woken up
+	Animator* m_Animators = nullptr;
+	int m_Count = 0;
+	float m_DeltaTime = 0.0f;
+	BonePaletteBuffer* m_Palette = nullptr;
+	std::atomic<int> m_NextChunk{ 0 };
+};
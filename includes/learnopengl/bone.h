@@ -5,6 +5,9 @@
 #include <vector>
 #include <assimp/scene.h>
 #include <list>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
 #include <glm/glm.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/quaternion.hpp>
@@ -28,14 +31,42 @@ struct KeyScale
 	float timeStamp;
 };
 
+/*
+	Compressed keys: 8 bytes each instead of 16 or 20. Values are 16 bit fractions of
+	the bounds of the track, rotations use the smallest three encoding (the largest
+	component is dropped and rebuilt from the unit length, its index is kept in the
+	top bits of the first two components) and time stamps are 16 bit fractions of the
+	last key time of the bone.
+*/
+struct PackedKey
+{
+	uint16_t value[3];
+	uint16_t timeStamp;
+};
+
+// maximum error allowed when dropping keys that the interpolation of their neighbours reproduces
+struct BoneCompressionSettings
+{
+	float positionTolerance = 0.001f; // model units
+	float rotationTolerance = 0.001f; // radians
+	float scaleTolerance = 0.001f;
+};
+
+// playback state of one bone, owned by the animator so that the bones of a clip stay immutable and shareable
+struct BoneCursor
+{
+	int position = 0;
+	int rotation = 0;
+	int scale = 0;
+};
+
 class Bone
 {
 public:
 	Bone(const std::string& name, int ID, const aiNodeAnim* channel)
 		:
 		m_Name(name),
-		m_ID(ID),
-		m_LocalTransform(1.0f)
+		m_ID(ID)
 	{
 		m_NumPositions = channel->mNumPositionKeys;
 
@@ -72,106 +103,368 @@ public:
 		}
 	}
 	
-	void Update(float animationTime)
+	// bone with already decoded keys, e.g. read from a cache
+	Bone(const std::string& name, int ID, std::vector<KeyPosition> positions, std::vector<KeyRotation> rotations, std::vector<KeyScale> scales)
+		:
+		m_Positions(std::move(positions)),
+		m_Rotations(std::move(rotations)),
+		m_Scales(std::move(scales)),
+		m_Name(name),
+		m_ID(ID)
 	{
-		glm::mat4 translation = InterpolatePosition(animationTime);
-		glm::mat4 rotation = InterpolateRotation(animationTime);
-		glm::mat4 scale = InterpolateScaling(animationTime);
-		m_LocalTransform = translation * rotation * scale;
+		m_NumPositions = static_cast<int>(m_Positions.size());
+		m_NumRotations = static_cast<int>(m_Rotations.size());
+		m_NumScalings = static_cast<int>(m_Scales.size());
 	}
-	glm::mat4 GetLocalTransform() { return m_LocalTransform; }
-	std::string GetBoneName() const { return m_Name; }
-	int GetBoneID() { return m_ID; }
-	
-
 
-	int GetPositionIndex(float animationTime)
+	// local transformation at animationTime. Only the cursor is modified: one bone may be evaluated
+	// concurrently by several animators, each with its own cursor.
+	glm::mat4 Evaluate(float animationTime, BoneCursor& cursor) const
 	{
-		for (int index = 0; index < m_NumPositions - 1; ++index)
+		glm::vec3 translation, scale;
+		glm::quat rotation;
+		if (m_Compressed)
 		{
-			if (animationTime < m_Positions[index + 1].timeStamp)
-				return index;
+			const float keyTime = animationTime * m_KeyTimeScale;
+			translation = InterpolatePacked(m_PackedPositions, keyTime, cursor.position, m_PositionMin, m_PositionStep);
+			rotation = InterpolatePackedRotation(keyTime, cursor.rotation);
+			scale = InterpolatePacked(m_PackedScales, keyTime, cursor.scale, m_ScaleMin, m_ScaleStep);
 		}
-		assert(0);
+		else
+		{
+			translation = InterpolatePosition(animationTime, cursor.position);
+			rotation = InterpolateRotation(animationTime, cursor.rotation);
+			scale = InterpolateScaling(animationTime, cursor.scale);
+		}
+
+		// translation * rotation * scale, written directly instead of multiplying three matrices
+		const glm::mat3 rotationMatrix = glm::mat3_cast(rotation);
+		glm::mat4 localTransform;
+		localTransform[0] = glm::vec4(rotationMatrix[0] * scale.x, 0.0f);
+		localTransform[1] = glm::vec4(rotationMatrix[1] * scale.y, 0.0f);
+		localTransform[2] = glm::vec4(rotationMatrix[2] * scale.z, 0.0f);
+		localTransform[3] = glm::vec4(translation, 1.0f);
+		return localTransform;
 	}
+	const std::string& GetBoneName() const { return m_Name; }
+	int GetBoneID() const { return m_ID; }
 
-	int GetRotationIndex(float animationTime)
+	/*
+		Load time compression, before any animator plays the bone: drops the keys that the
+		interpolation of the kept keys reproduces within the tolerances (a constant track
+		keeps a single key), then quantizes the remaining keys to PackedKey.
+	*/
+	void Compress(const BoneCompressionSettings& settings = BoneCompressionSettings())
 	{
-		for (int index = 0; index < m_NumRotations - 1; ++index)
-		{
-			if (animationTime < m_Rotations[index + 1].timeStamp)
-				return index;
-		}
-		assert(0);
+		if (m_Compressed)
+			return;
+
+		m_Positions = ReduceKeys(m_Positions, [&](const KeyPosition& a, const KeyPosition& b, float factor, const KeyPosition& key)
+			{ return glm::length(glm::mix(a.position, b.position, factor) - key.position) <= settings.positionTolerance; });
+		m_Rotations = ReduceKeys(m_Rotations, [&](const KeyRotation& a, const KeyRotation& b, float factor, const KeyRotation& key)
+			{ return RotationAngle(glm::normalize(glm::slerp(a.orientation, b.orientation, factor)), key.orientation) <= settings.rotationTolerance; });
+		m_Scales = ReduceKeys(m_Scales, [&](const KeyScale& a, const KeyScale& b, float factor, const KeyScale& key)
+			{ return glm::length(glm::mix(a.scale, b.scale, factor) - key.scale) <= settings.scaleTolerance; });
+
+		std::vector<float> times;
+		for (const KeyPosition& key : m_Positions) times.push_back(key.timeStamp);
+		for (const KeyRotation& key : m_Rotations) times.push_back(key.timeStamp);
+		for (const KeyScale& key : m_Scales) times.push_back(key.timeStamp);
+		m_KeyTimeScale = GetKeyTimeScale(times);
+
+		PackVectors(m_Positions, &KeyPosition::position, m_PackedPositions, m_PositionMin, m_PositionStep);
+		PackVectors(m_Scales, &KeyScale::scale, m_PackedScales, m_ScaleMin, m_ScaleStep);
+		m_PackedRotations.clear();
+		for (const KeyRotation& key : m_Rotations)
+			m_PackedRotations.push_back(PackRotation(key.orientation, PackTime(key.timeStamp)));
+
+		m_NumPositions = static_cast<int>(m_PackedPositions.size());
+		m_NumRotations = static_cast<int>(m_PackedRotations.size());
+		m_NumScalings = static_cast<int>(m_PackedScales.size());
+		m_Positions.clear();
+		m_Rotations.clear();
+		m_Scales.clear();
+		m_Compressed = true;
 	}
 
-	int GetScaleIndex(float animationTime)
+	bool IsCompressed() const { return m_Compressed; }
+
+	// keys of an uncompressed bone
+	const std::vector<KeyPosition>& GetPositionKeys() const { return m_Positions; }
+	const std::vector<KeyRotation>& GetRotationKeys() const { return m_Rotations; }
+	const std::vector<KeyScale>& GetScaleKeys() const { return m_Scales; }
+
+	int GetKeyCount() const
 	{
-		for (int index = 0; index < m_NumScalings - 1; ++index)
-		{
-			if (animationTime < m_Scales[index + 1].timeStamp)
-				return index;
-		}
-		assert(0);
+		if (m_Compressed)
+			return static_cast<int>(m_PackedPositions.size() + m_PackedRotations.size() + m_PackedScales.size());
+		return static_cast<int>(m_Positions.size() + m_Rotations.size() + m_Scales.size());
+	}
+
+	// bytes of key data, bounds included
+	size_t GetMemorySize() const
+	{
+		if (m_Compressed)
+			return (m_PackedPositions.size() + m_PackedRotations.size() + m_PackedScales.size()) * sizeof(PackedKey) + 4 * sizeof(glm::vec3) + sizeof(float);
+		return m_Positions.size() * sizeof(KeyPosition) + m_Rotations.size() * sizeof(KeyRotation) + m_Scales.size() * sizeof(KeyScale);
+	}
+	
+
+
+	/*
+		Index of the key starting the segment that contains animationTime, clamped to
+		the first and the last segments. The cursor of the track is the last segment
+		found: during playback the time moves forward so the answer is the same segment
+		or the next one, and only seeks and loops fall back to a binary search.
+	*/
+	int GetPositionIndex(float animationTime, int& cursor) const
+	{
+		return FindKeyIndex(m_Positions, animationTime, cursor);
+	}
+
+	int GetRotationIndex(float animationTime, int& cursor) const
+	{
+		return FindKeyIndex(m_Rotations, animationTime, cursor);
+	}
+
+	int GetScaleIndex(float animationTime, int& cursor) const
+	{
+		return FindKeyIndex(m_Scales, animationTime, cursor);
 	}
 
 
 private:
 
-	float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime)
+	template<typename TKey>
+	static int FindKeyIndex(const std::vector<TKey>& keys, float animationTime, int& cursor)
+	{
+		const int lastSegment = static_cast<int>(keys.size()) - 2;
+		if (lastSegment <= 0)
+			return 0;
+		// a cursor left by a track with more keys
+		cursor = std::min(cursor, lastSegment);
+
+		// same segment, or the next one
+		if (keys[cursor].timeStamp <= animationTime)
+		{
+			if (cursor == lastSegment || animationTime < keys[cursor + 1].timeStamp)
+				return cursor;
+			if (cursor + 1 == lastSegment || animationTime < keys[cursor + 2].timeStamp)
+				return ++cursor;
+		}
+
+		// seek or loop: first key after animationTime, the segment starts one key before
+		auto next = std::upper_bound(keys.begin(), keys.end(), animationTime,
+			[](float time, const TKey& key) { return time < key.timeStamp; });
+		cursor = std::max(0, std::min(static_cast<int>(next - keys.begin()) - 1, lastSegment));
+		return cursor;
+	}
+
+	float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime) const
 	{
 		float scaleFactor = 0.0f;
 		float midWayLength = animationTime - lastTimeStamp;
 		float framesDiff = nextTimeStamp - lastTimeStamp;
+		if (framesDiff <= 0.0f)
+			return 0.0f;
 		scaleFactor = midWayLength / framesDiff;
-		return scaleFactor;
+		// before the first key or after the last one, hold the key
+		return glm::clamp(scaleFactor, 0.0f, 1.0f);
 	}
 
-	glm::mat4 InterpolatePosition(float animationTime)
+	glm::vec3 InterpolatePosition(float animationTime, int& cursor) const
 	{
 		if (1 == m_NumPositions)
-			return glm::translate(glm::mat4(1.0f), m_Positions[0].position);
+			return m_Positions[0].position;
 
-		int p0Index = GetPositionIndex(animationTime);
+		int p0Index = GetPositionIndex(animationTime, cursor);
 		int p1Index = p0Index + 1;
 		float scaleFactor = GetScaleFactor(m_Positions[p0Index].timeStamp,
 			m_Positions[p1Index].timeStamp, animationTime);
-		glm::vec3 finalPosition = glm::mix(m_Positions[p0Index].position, m_Positions[p1Index].position
+		return glm::mix(m_Positions[p0Index].position, m_Positions[p1Index].position
 			, scaleFactor);
-		return glm::translate(glm::mat4(1.0f), finalPosition);
 	}
 
-	glm::mat4 InterpolateRotation(float animationTime)
+	glm::quat InterpolateRotation(float animationTime, int& cursor) const
 	{
 		if (1 == m_NumRotations)
-		{
-			auto rotation = glm::normalize(m_Rotations[0].orientation);
-			return glm::toMat4(rotation);
-		}
+			return glm::normalize(m_Rotations[0].orientation);
 
-		int p0Index = GetRotationIndex(animationTime);
+		int p0Index = GetRotationIndex(animationTime, cursor);
 		int p1Index = p0Index + 1;
 		float scaleFactor = GetScaleFactor(m_Rotations[p0Index].timeStamp,
 			m_Rotations[p1Index].timeStamp, animationTime);
 		glm::quat finalRotation = glm::slerp(m_Rotations[p0Index].orientation, m_Rotations[p1Index].orientation
 			, scaleFactor);
-		finalRotation = glm::normalize(finalRotation);
-		return glm::toMat4(finalRotation);
-
+		return glm::normalize(finalRotation);
 	}
 
-	glm::mat4 Bone::InterpolateScaling(float animationTime)
+	glm::vec3 InterpolateScaling(float animationTime, int& cursor) const
 	{
 		if (1 == m_NumScalings)
-			return glm::scale(glm::mat4(1.0f), m_Scales[0].scale);
+			return m_Scales[0].scale;
 
-		int p0Index = GetScaleIndex(animationTime);
+		int p0Index = GetScaleIndex(animationTime, cursor);
 		int p1Index = p0Index + 1;
 		float scaleFactor = GetScaleFactor(m_Scales[p0Index].timeStamp,
 			m_Scales[p1Index].timeStamp, animationTime);
-		glm::vec3 finalScale = glm::mix(m_Scales[p0Index].scale, m_Scales[p1Index].scale
+		return glm::mix(m_Scales[p0Index].scale, m_Scales[p1Index].scale
 			, scaleFactor);
-		return glm::scale(glm::mat4(1.0f), finalScale);
+	}
+
+	// key reduction: greedy extension of every segment as long as all the keys it skips are reproduced
+	template<typename TKey, typename TFits>
+	static std::vector<TKey> ReduceKeys(const std::vector<TKey>& keys, TFits fits)
+	{
+		if (keys.size() <= 2)
+			return keys;
+
+		std::vector<TKey> kept(1, keys[0]);
+		size_t anchor = 0;
+		for (size_t end = 2; end < keys.size(); ++end)
+		{
+			for (size_t skipped = anchor + 1; skipped < end; ++skipped)
+			{
+				const float span = keys[end].timeStamp - keys[anchor].timeStamp;
+				const float factor = span > 0.0f ? (keys[skipped].timeStamp - keys[anchor].timeStamp) / span : 0.0f;
+				if (!fits(keys[anchor], keys[end], factor, keys[skipped]))
+				{
+					anchor = end - 1;
+					kept.push_back(keys[anchor]);
+					break;
+				}
+			}
+		}
+		kept.push_back(keys.back());
+
+		// constant track: both remaining keys hold the same value
+		if (kept.size() == 2 && fits(kept[0], kept[0], 0.0f, kept[1]))
+			kept.pop_back();
+		return kept;
+	}
+
+	// from the chord between the quaternions, accurate for small angles unlike acos of the dot product
+	static float RotationAngle(const glm::quat& a, const glm::quat& b)
+	{
+		const glm::vec4 va(a.x, a.y, a.z, a.w);
+		const glm::vec4 vb(b.x, b.y, b.z, b.w);
+		const float chord = glm::length(glm::dot(va, vb) < 0.0f ? va + vb : va - vb);
+		return 4.0f * std::asin(std::min(1.0f, chord * 0.5f));
+	}
+
+	// keys exported at a fixed frame rate keep exact frame numbers, other time stamps use the whole 16 bit range
+	static float GetKeyTimeScale(std::vector<float>& times)
+	{
+		std::sort(times.begin(), times.end());
+		times.erase(std::unique(times.begin(), times.end()), times.end());
+		const float lastTime = times.back();
+		if (lastTime <= 0.0f)
+			return 0.0f;
+
+		float frameTime = lastTime;
+		for (size_t i = 1; i < times.size(); ++i)
+			frameTime = std::min(frameTime, times[i] - times[i - 1]);
+		bool onFrames = lastTime / frameTime <= 65535.0f;
+		for (size_t i = 0; i < times.size() && onFrames; ++i)
+		{
+			const float frame = times[i] / frameTime;
+			onFrames = std::abs(frame - std::round(frame)) < 0.001f;
+		}
+		return onFrames ? 1.0f / frameTime : 65535.0f / lastTime;
+	}
+
+	uint16_t PackTime(float timeStamp) const
+	{
+		return static_cast<uint16_t>(std::lround(glm::clamp(timeStamp * m_KeyTimeScale, 0.0f, 65535.0f)));
+	}
+
+	template<typename TKey>
+	void PackVectors(const std::vector<TKey>& keys, glm::vec3 TKey::*value, std::vector<PackedKey>& packed, glm::vec3& minimum, glm::vec3& step)
+	{
+		glm::vec3 maximum = keys[0].*value;
+		minimum = maximum;
+		for (const TKey& key : keys)
+		{
+			minimum = glm::min(minimum, key.*value);
+			maximum = glm::max(maximum, key.*value);
+		}
+		step = (maximum - minimum) / 65535.0f;
+
+		packed.clear();
+		for (const TKey& key : keys)
+		{
+			PackedKey data;
+			for (int i = 0; i < 3; ++i)
+				data.value[i] = step[i] > 0.0f ? static_cast<uint16_t>(std::lround(((key.*value)[i] - minimum[i]) / step[i])) : 0;
+			data.timeStamp = PackTime(key.timeStamp);
+			packed.push_back(data);
+		}
+	}
+
+	// smallest three: 15 bits per kept component in [-1/sqrt(2), 1/sqrt(2)], the largest one is positive
+	static PackedKey PackRotation(glm::quat orientation, uint16_t timeStamp)
+	{
+		orientation = glm::normalize(orientation);
+		const float components[4] = { orientation.x, orientation.y, orientation.z, orientation.w };
+		int largest = 0;
+		for (int i = 1; i < 4; ++i)
+			if (std::abs(components[i]) > std::abs(components[largest]))
+				largest = i;
+		const float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+		PackedKey data;
+		for (int i = 0, kept = 0; i < 4; ++i)
+		{
+			if (i == largest)
+				continue;
+			const float normalized = glm::clamp(sign * components[i] * 0.70710678f + 0.5f, 0.0f, 1.0f);
+			data.value[kept++] = static_cast<uint16_t>(std::lround(normalized * 32767.0f));
+		}
+		data.value[0] |= (largest & 1) << 15;
+		data.value[1] |= (largest >> 1) << 15;
+		data.timeStamp = timeStamp;
+		return data;
+	}
+
+	static glm::quat UnpackRotation(const PackedKey& data)
+	{
+		const int largest = (data.value[0] >> 15) | ((data.value[1] >> 15) << 1);
+		float components[4];
+		float sum = 0.0f;
+		for (int i = 0, kept = 0; i < 4; ++i)
+		{
+			if (i == largest)
+				continue;
+			components[i] = ((data.value[kept++] & 0x7fff) / 32767.0f - 0.5f) * 1.41421356f;
+			sum += components[i] * components[i];
+		}
+		components[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+		return glm::quat(components[3], components[0], components[1], components[2]);
+	}
+
+	static glm::vec3 UnpackVector(const PackedKey& data, const glm::vec3& minimum, const glm::vec3& step)
+	{
+		return minimum + step * glm::vec3(data.value[0], data.value[1], data.value[2]);
+	}
+
+	glm::vec3 InterpolatePacked(const std::vector<PackedKey>& keys, float keyTime, int& cursor, const glm::vec3& minimum, const glm::vec3& step) const
+	{
+		if (keys.size() == 1)
+			return UnpackVector(keys[0], minimum, step);
+
+		const int p0Index = FindKeyIndex(keys, keyTime, cursor);
+		const float scaleFactor = GetScaleFactor(keys[p0Index].timeStamp, keys[p0Index + 1].timeStamp, keyTime);
+		return glm::mix(UnpackVector(keys[p0Index], minimum, step), UnpackVector(keys[p0Index + 1], minimum, step), scaleFactor);
+	}
+
+	glm::quat InterpolatePackedRotation(float keyTime, int& cursor) const
+	{
+		if (m_PackedRotations.size() == 1)
+			return UnpackRotation(m_PackedRotations[0]);
+
+		const int p0Index = FindKeyIndex(m_PackedRotations, keyTime, cursor);
+		const float scaleFactor = GetScaleFactor(m_PackedRotations[p0Index].timeStamp, m_PackedRotations[p0Index + 1].timeStamp, keyTime);
+		return glm::normalize(glm::slerp(UnpackRotation(m_PackedRotations[p0Index]), UnpackRotation(m_PackedRotations[p0Index + 1]), scaleFactor));
 	}
 
 	std::vector<KeyPosition> m_Positions;
@@ -181,7 +474,15 @@ private:
 	int m_NumRotations;
 	int m_NumScalings;
 
-	glm::mat4 m_LocalTransform;
+	// compressed keys, replacing the ones above once Compress is called
+	bool m_Compressed = false;
+	std::vector<PackedKey> m_PackedPositions;
+	std::vector<PackedKey> m_PackedRotations;
+	std::vector<PackedKey> m_PackedScales;
+	glm::vec3 m_PositionMin, m_PositionStep;
+	glm::vec3 m_ScaleMin, m_ScaleStep;
+	float m_KeyTimeScale = 0.0f; // animation ticks to 16 bit time stamps
+
 	std::string m_Name;
 	int m_ID;
 };
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <learnopengl/dual_quaternion.h>
+
+// maximum number of bones of one character, must match the size of the palette array in the shaders
+const int MAX_BONES = 100;
+
+enum BonePaletteStorage
+{
+	BONE_PALETTE_UNIFORM_BUFFER, // GL 3.3: std140 uniform block, one palette bound at a time with glBindBufferRange
+	BONE_PALETTE_TEXTURE_BUFFER, // GL 3.3: RGBA32F texture buffer, 4 texels per matrix, indexed by palette offset
+	BONE_PALETTE_STORAGE_BUFFER  // GL 4.3: std430 storage buffer, the whole frame is bound once and indexed by palette offset
+};
+
+enum BonePaletteFormat
+{
+	BONE_PALETTE_MATRICES,         // glm::mat4 per bone, 64 bytes (4 texels in a texture buffer)
+	BONE_PALETTE_DUAL_QUATERNIONS  // BoneDualQuaternion per bone, 32 bytes (2 texels), rigid skeletons only
+};
+
+/*
+	Final bone matrices of all the characters of a frame, written by the animators
+	directly in the mapped buffer instead of going through a std::vector and one
+	glUniformMatrix4fv per bone.
+
+	The palettes are kept in a ring of FRAME_COUNT buffers, each one holding the
+	palettes of maxCharacters characters. Every frame maps the next buffer
+	unsynchronized and a fence placed after the draws of a frame protects its buffer
+	until the GPU is done with it, so the map never stalls on the draws in flight.
+
+	Texture and storage buffers pack the palettes with bonesPerCharacter matrices
+	each, so a whole crowd is bound once and every instance selects its palette with
+	its offset. Uniform buffers always hold MAX_BONES matrices per palette.
+
+	With the dual quaternion format every bone takes half the size: twice as many
+	characters per buffer and half the bytes written per frame. The animators then
+	write in GetDualQuaternionPalette instead of GetPalette.
+
+	Usage per frame:
+		BeginFrame();
+		animator.UpdateAnimation(dt, palette.GetPalette(character)); // for every character
+		EndFrame();
+		shader.setInt("paletteOffset", palette.BindPalette(character)); // before every draw
+		FenceFrame();
+*/
+class BonePaletteBuffer
+{
+public:
+	static const int FRAME_COUNT = 3;
+
+	// binding is the uniform/storage buffer binding point, or the texture unit of a texture buffer
+	BonePaletteBuffer(int maxCharacters, BonePaletteStorage storage = BONE_PALETTE_UNIFORM_BUFFER, unsigned int binding = 0, int bonesPerCharacter = MAX_BONES,
+		BonePaletteFormat format = BONE_PALETTE_MATRICES)
+		: m_MaxCharacters(maxCharacters), m_Storage(storage), m_Binding(binding), m_Format(format)
+	{
+		m_BonesPerCharacter = storage == BONE_PALETTE_UNIFORM_BUFFER ? MAX_BONES : bonesPerCharacter;
+		m_Target = storage == BONE_PALETTE_UNIFORM_BUFFER ? GL_UNIFORM_BUFFER
+			: storage == BONE_PALETTE_TEXTURE_BUFFER ? GL_TEXTURE_BUFFER : GL_SHADER_STORAGE_BUFFER;
+
+		// uniform buffer ranges must start on the offset alignment of the implementation, other palettes are packed
+		const GLsizeiptr paletteSize = m_BonesPerCharacter * GetBoneSize(format);
+		m_PaletteStride = paletteSize;
+		if (storage == BONE_PALETTE_UNIFORM_BUFFER)
+		{
+			GLint alignment = 256;
+			glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+			m_PaletteStride = (paletteSize + alignment - 1) / alignment * alignment;
+		}
+		m_FrameSize = m_PaletteStride * maxCharacters;
+
+		glGenBuffers(FRAME_COUNT, m_Buffers);
+		for (int i = 0; i < FRAME_COUNT; ++i)
+		{
+			glBindBuffer(m_Target, m_Buffers[i]);
+			glBufferData(m_Target, m_FrameSize, NULL, GL_STREAM_DRAW);
+			m_Fences[i] = 0;
+		}
+		glBindBuffer(m_Target, 0);
+
+		std::fill(m_Textures, m_Textures + FRAME_COUNT, 0u);
+		if (storage == BONE_PALETTE_TEXTURE_BUFFER)
+		{
+			glGenTextures(FRAME_COUNT, m_Textures);
+			for (int i = 0; i < FRAME_COUNT; ++i)
+			{
+				glBindTexture(GL_TEXTURE_BUFFER, m_Textures[i]);
+				glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_Buffers[i]);
+			}
+			glBindTexture(GL_TEXTURE_BUFFER, 0);
+		}
+	}
+
+	~BonePaletteBuffer()
+	{
+		for (int i = 0; i < FRAME_COUNT; ++i)
+			if (m_Fences[i])
+				glDeleteSync(m_Fences[i]);
+		if (m_Storage == BONE_PALETTE_TEXTURE_BUFFER)
+			glDeleteTextures(FRAME_COUNT, m_Textures);
+		glDeleteBuffers(FRAME_COUNT, m_Buffers);
+	}
+
+	BonePaletteBuffer(const BonePaletteBuffer&) = delete;
+	BonePaletteBuffer& operator=(const BonePaletteBuffer&) = delete;
+
+	// maps the buffer of the next frame, waiting first for the GPU to be done with its previous use.
+	// Returns false if the buffer couldn't be mapped: the palettes of this frame must not be written (see IsMapped)
+	bool BeginFrame()
+	{
+		m_Frame = (m_Frame + 1) % FRAME_COUNT;
+		GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+		if (m_Fences[m_Frame])
+		{
+			const GLenum wait = glClientWaitSync(m_Fences[m_Frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			// timed out or failed: the GPU may still read the buffer, the driver has to synchronize the map
+			if (wait != GL_ALREADY_SIGNALED && wait != GL_CONDITION_SATISFIED)
+				access &= ~GL_MAP_UNSYNCHRONIZED_BIT;
+			glDeleteSync(m_Fences[m_Frame]);
+			m_Fences[m_Frame] = 0;
+		}
+
+		glBindBuffer(m_Target, m_Buffers[m_Frame]);
+		m_Mapped = (char*)glMapBufferRange(m_Target, 0, m_FrameSize, access);
+		glBindBuffer(m_Target, 0);
+		if (!m_Mapped)
+			std::cout << "ERROR::BONE_PALETTE: failed to map the palettes of the frame, GL error " << glGetError() << std::endl;
+		return m_Mapped != nullptr;
+	}
+
+	// false between BeginFrame and EndFrame if the map failed, GetPalette must not be called then
+	bool IsMapped() const { return m_Mapped != nullptr; }
+
+	// bones per character write only matrices of the character in the mapped buffer: never read from them
+	glm::mat4* GetPalette(int character)
+	{
+		return reinterpret_cast<glm::mat4*>(m_Mapped + character * m_PaletteStride);
+	}
+
+	// same as GetPalette for the dual quaternion format
+	BoneDualQuaternion* GetDualQuaternionPalette(int character)
+	{
+		return reinterpret_cast<BoneDualQuaternion*>(m_Mapped + character * m_PaletteStride);
+	}
+
+	void EndFrame()
+	{
+		if (!m_Mapped)
+			return;
+		glBindBuffer(m_Target, m_Buffers[m_Frame]);
+		glUnmapBuffer(m_Target);
+		glBindBuffer(m_Target, 0);
+		m_Mapped = nullptr;
+	}
+
+	// binds the palette of the character and returns the index of its first matrix in the bound range,
+	// to add to the bone ids in the shader (always 0 for uniform buffers)
+	int BindPalette(int character)
+	{
+		if (m_Storage == BONE_PALETTE_UNIFORM_BUFFER)
+		{
+			glBindBufferRange(GL_UNIFORM_BUFFER, m_Binding, m_Buffers[m_Frame], character * m_PaletteStride, MAX_BONES * GetBoneSize(m_Format));
+			return 0;
+		}
+		BindFrame();
+		return GetPaletteOffset(character);
+	}
+
+	// texture and storage buffers only: binds all the palettes of the frame, the shader selects one with its palette offset
+	void BindFrame()
+	{
+		if (m_Storage == BONE_PALETTE_TEXTURE_BUFFER)
+		{
+			glActiveTexture(GL_TEXTURE0 + m_Binding);
+			glBindTexture(GL_TEXTURE_BUFFER, m_Textures[m_Frame]);
+			glActiveTexture(GL_TEXTURE0);
+		}
+		else
+		{
+			glBindBufferBase(m_Target, m_Binding, m_Buffers[m_Frame]);
+		}
+	}
+
+	// index of the first matrix of the character in the frame (texture and storage buffers)
+	int GetPaletteOffset(int character) const { return character * m_BonesPerCharacter; }
+
+	// to call after the last draw reading the palettes of the frame
+	void FenceFrame()
+	{
+		m_Fences[m_Frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	// connects the BonePalette block or sampler of a program to the binding of the buffer (not needed with a layout binding)
+	void AttachShader(unsigned int program) const
+	{
+		if (m_Storage == BONE_PALETTE_UNIFORM_BUFFER)
+		{
+			const unsigned int blockIndex = glGetUniformBlockIndex(program, "BonePalette");
+			if (blockIndex != GL_INVALID_INDEX)
+				glUniformBlockBinding(program, blockIndex, m_Binding);
+		}
+		else if (m_Storage == BONE_PALETTE_TEXTURE_BUFFER)
+		{
+			glUseProgram(program);
+			glUniform1i(glGetUniformLocation(program, "bonePalette"), m_Binding);
+		}
+	}
+
+	int GetMaxCharacters() const { return m_MaxCharacters; }
+	int GetBonesPerCharacter() const { return m_BonesPerCharacter; }
+	BonePaletteStorage GetStorage() const { return m_Storage; }
+	BonePaletteFormat GetFormat() const { return m_Format; }
+	// bytes mapped and uploaded every frame
+	size_t GetFrameSize() const { return static_cast<size_t>(m_FrameSize); }
+
+	static size_t GetBoneSize(BonePaletteFormat format)
+	{
+		return format == BONE_PALETTE_DUAL_QUATERNIONS ? sizeof(BoneDualQuaternion) : sizeof(glm::mat4);
+	}
+
+	// largest crowd a texture buffer palette can hold on this implementation
+	static int GetMaxTextureBufferCharacters(int bonesPerCharacter, BonePaletteFormat format = BONE_PALETTE_MATRICES)
+	{
+		GLint maxTexels = 65536;
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+		return maxTexels / (bonesPerCharacter * static_cast<int>(GetBoneSize(format) / sizeof(glm::vec4)));
+	}
+
+private:
+	int m_MaxCharacters;
+	BonePaletteStorage m_Storage;
+	unsigned int m_Binding;
+	BonePaletteFormat m_Format;
+	int m_BonesPerCharacter;
+	GLenum m_Target;
+	unsigned int m_Buffers[FRAME_COUNT];
+	unsigned int m_Textures[FRAME_COUNT];
+	GLsizeiptr m_PaletteStride = 0;
+	GLsizeiptr m_FrameSize = 0;
+	int m_Frame = FRAME_COUNT - 1;
+	char* m_Mapped = nullptr;
+	GLsync m_Fences[FRAME_COUNT];
+};
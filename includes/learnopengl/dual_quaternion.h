@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+/*
+	Rigid bone transformation as a unit dual quaternion: real is the rotation and
+	dual is half the translation times the rotation, both stored as (x, y, z, w).
+	32 bytes instead of the 64 of a glm::mat4, and blending dual quaternions in the
+	vertex shader keeps the volume of twisted joints where blended matrices collapse.
+
+	Dual quaternions have no scale: the columns of the converted matrices are
+	normalized, so the skeletons played with them must be rigid (scales of 1).
+*/
+struct BoneDualQuaternion
+{
+	glm::vec4 real;
+	glm::vec4 dual;
+};
+
+inline BoneDualQuaternion ToDualQuaternion(const glm::mat4& transform)
+{
+	const glm::mat3 rotation(glm::normalize(glm::vec3(transform[0])), glm::normalize(glm::vec3(transform[1])), glm::normalize(glm::vec3(transform[2])));
+	const glm::quat real = glm::quat_cast(rotation);
+	const glm::vec3 translation(transform[3]);
+	const glm::quat dual = glm::quat(0.0f, translation.x, translation.y, translation.z) * real * 0.5f;
+
+	BoneDualQuaternion result;
+	result.real = glm::vec4(real.x, real.y, real.z, real.w);
+	result.dual = glm::vec4(dual.x, dual.y, dual.z, dual.w);
+	return result;
+}
+
+// out is only written, it may point to write combined memory
+inline void ToDualQuaternions(const glm::mat4* pose, int count, BoneDualQuaternion* out)
+{
+	for (int i = 0; i < count; ++i)
+		out[i] = ToDualQuaternion(pose[i]);
+}
+
+// same transformation of a point as the skinning shaders, for tests on the CPU
+inline glm::vec3 TransformPoint(const BoneDualQuaternion& transform, const glm::vec3& point)
+{
+	const glm::vec3 real(transform.real);
+	const glm::vec3 dual(transform.dual);
+	const glm::vec3 rotated = point + 2.0f * glm::cross(real, glm::cross(real, point) + transform.real.w * point);
+	return rotated + 2.0f * (transform.real.w * dual - transform.dual.w * real + glm::cross(real, dual));
+}
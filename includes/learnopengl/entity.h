@@ -5,6 +5,12 @@
 #include <list> //std::list
 #include <array> //std::array
 #include <memory> //std::unique_ptr
+#include <vector> //std::vector
+
+#include <learnopengl/occlusion_culling.h>
+#include <learnopengl/hiz_culling.h>
+#include <learnopengl/instancing.h>
+#include <learnopengl/spatial_index.h>
 
 class Transform
 {
@@ -63,7 +69,7 @@ public:
 		m_isDirty = true;
 	}
 
-	const glm::vec3& getGlobalPosition() const
+	glm::vec3 getGlobalPosition() const
 	{
 		return m_modelMatrix[3];
 	}
@@ -341,6 +347,16 @@ Frustum createFrustumFromCamera(const Camera& cam, float aspect, float fovY, flo
 	return frustum;
 }
 
+//Same frustum as planes, for the queries of the spatial index
+FrustumPlanes getFrustumPlanes(const Frustum& frustum)
+{
+	FrustumPlanes planes;
+	const Plan* faces[6] = { &frustum.leftFace, &frustum.rightFace, &frustum.bottomFace, &frustum.topFace, &frustum.nearFace, &frustum.farFace };
+	for (unsigned int i = 0; i < 6; ++i)
+		planes[i] = glm::vec4(faces[i]->normal, -faces[i]->distance);
+	return planes;
+}
+
 AABB generateAABB(const Model& model)
 {
 	glm::vec3 minAABB = glm::vec3(std::numeric_limits<float>::max());
@@ -395,6 +411,10 @@ public:
 	Model* pModel = nullptr;
 	std::unique_ptr<AABB> boundingVolume;
 
+	//Spatial index the entity is registered in, kept up to date when its transform is updated
+	LooseOctree<Entity>* spatialIndex = nullptr;
+	unsigned int spatialHandle = LooseOctree<Entity>::INVALID_INDEX;
+
 
 	// constructor, expects a filepath to a 3D model.
 	Entity(Model& model) : pModel{ &model }
@@ -403,6 +423,12 @@ public:
 		//boundingVolume = std::make_unique<Sphere>(generateSphereBV(model));
 	}
 
+	~Entity()
+	{
+		if (spatialIndex)
+			spatialIndex->remove(spatialHandle);
+	}
+
 	AABB getGlobalAABB()
 	{
 		//Get global scale thanks to our transform
@@ -445,6 +471,21 @@ public:
 		forceUpdateSelfAndChild();
 	}
 
+	//Register the entity and its children in the spatial index, with their global AABB
+	void registerSelfAndChild(LooseOctree<Entity>& index)
+	{
+		const AABB globalAABB = getGlobalAABB();
+		if (spatialIndex)
+			spatialIndex->remove(spatialHandle);
+		spatialIndex = &index;
+		spatialHandle = index.insert(this, globalAABB.center, globalAABB.extents);
+
+		for (auto&& child : children)
+		{
+			child->registerSelfAndChild(index);
+		}
+	}
+
 	//Force update of transform even if local space don't change
 	void forceUpdateSelfAndChild()
 	{
@@ -453,6 +494,12 @@ public:
 		else
 			transform.computeModelMatrix();
 
+		if (spatialIndex)
+		{
+			const AABB globalAABB = getGlobalAABB();
+			spatialIndex->update(spatialHandle, globalAABB.center, globalAABB.extents);
+		}
+
 		for (auto&& child : children)
 		{
 			child->forceUpdateSelfAndChild();
@@ -460,19 +507,97 @@ public:
 	}
 
 
-	void drawSelfAndChild(const Frustum& frustum, Shader& ourShader, unsigned int& display, unsigned int& total)
+	//Draw the model now, or queue it in batcher to be drawn instanced with the other entities sharing the model and the shader
+	void draw(Shader& ourShader, InstanceBatcher* batcher = nullptr)
 	{
-		if (boundingVolume->isOnFrustum(frustum, transform))
+		if (batcher)
+		{
+			batcher->add(*pModel, ourShader, transform.getModelMatrix());
+		}
+		else
 		{
 			ourShader.setMat4("model", transform.getModelMatrix());
 			pModel->Draw(ourShader);
+		}
+	}
+
+	//With a batcher, nothing is drawn until batcher.flush()
+	void drawSelfAndChild(const Frustum& frustum, Shader& ourShader, unsigned int& display, unsigned int& total, InstanceBatcher* batcher = nullptr)
+	{
+		if (boundingVolume->isOnFrustum(frustum, transform))
+		{
+			draw(ourShader, batcher);
 			display++;
 		}
 		total++;
 
 		for (auto&& child : children)
 		{
-			child->drawSelfAndChild(frustum, ourShader, display, total);
+			child->drawSelfAndChild(frustum, ourShader, display, total, batcher);
+		}
+	}
+
+	//Same as above but entities that pass the frustum test are also tested against the occluders rendered in occlusionCuller
+	void drawSelfAndChild(const Frustum& frustum, OcclusionCuller& occlusionCuller, Shader& ourShader, unsigned int& display, unsigned int& total, InstanceBatcher* batcher = nullptr)
+	{
+		if (boundingVolume->isOnFrustum(frustum, transform))
+		{
+			const AABB globalAABB = getGlobalAABB();
+			if (occlusionCuller.testAABB(globalAABB.center, globalAABB.extents))
+			{
+				draw(ourShader, batcher);
+				display++;
+			}
+		}
+		total++;
+
+		for (auto&& child : children)
+		{
+			child->drawSelfAndChild(frustum, occlusionCuller, ourShader, display, total, batcher);
+		}
+	}
+
+	//Phase 1 of the Hi-Z occlusion culling: draw the entities visible in the pyramid of the previous frame.
+	//The others are pushed in occluded, to be tested again by drawDisoccluded once the pyramid of this frame is built.
+	//With a batcher, flush it before building the pyramid.
+	void drawSelfAndChild(const Frustum& frustum, const HiZPyramid& previousHiZ, Shader& ourShader, std::vector<Entity*>& occluded, HiZStats& stats, unsigned int& total, InstanceBatcher* batcher = nullptr)
+	{
+		if (boundingVolume->isOnFrustum(frustum, transform))
+		{
+			const AABB globalAABB = getGlobalAABB();
+			if (previousHiZ.isVisible(globalAABB.center, globalAABB.extents))
+			{
+				draw(ourShader, batcher);
+				stats.firstPhaseDrawn++;
+			}
+			else
+			{
+				occluded.push_back(this);
+			}
+		}
+		total++;
+
+		for (auto&& child : children)
+		{
+			child->drawSelfAndChild(frustum, previousHiZ, ourShader, occluded, stats, total, batcher);
+		}
+	}
+
+	//Phase 2 of the Hi-Z occlusion culling: draw the entities rejected by phase 1 that are visible in the pyramid of this frame
+	static void drawDisoccluded(const std::vector<Entity*>& occluded, const HiZPyramid& hiZ, Shader& ourShader, HiZStats& stats, InstanceBatcher* batcher = nullptr)
+	{
+		for (Entity* entity : occluded)
+		{
+			const AABB globalAABB = entity->getGlobalAABB();
+			if (hiZ.isVisible(globalAABB.center, globalAABB.extents))
+			{
+				entity->draw(ourShader, batcher);
+				stats.secondPhaseDrawn++;
+			}
+			else
+			{
+				stats.culled++;
+			}
 		}
 	}
 };
@@ -0,0 +1,308 @@
+#ifndef HIZ_CULLING_H
+#define HIZ_CULLING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp> //glm::mat4
+#include <vector> //std::vector
+#include <algorithm> //std::min, std::max
+#include <cmath> //std::log2, std::ceil
+#include <iostream> //std::cout
+
+struct HiZStats
+{
+	unsigned int firstPhaseDrawn = 0;  //Visible in the pyramid of the previous frame
+	unsigned int secondPhaseDrawn = 0; //Hidden in the previous frame but visible in the pyramid of this frame (disoccluded)
+	unsigned int culled = 0;           //Hidden in both pyramids
+};
+
+//Hierarchical-Z pyramid built on the GPU from a depth texture.
+//Level 0 is half the resolution of the depth buffer and every level keeps the farthest depth of the texels it covers, so
+//a box whose nearest depth is behind the texels covering its screen rectangle is hidden.
+//The usual way to use it is the two phase scheme:
+// 1. test against the pyramid of the previous frame and draw what is visible,
+// 2. build the pyramid from the depth of phase 1 and test again what was rejected, drawing the objects that became visible.
+//Phase 2 prevents the popping of objects disoccluded since the previous frame and its pyramid is reused by the next frame.
+class HiZPyramid
+{
+public:
+	//cpuCopy: read back the coarse levels after each build to test bounding boxes on the CPU (stall the pipeline)
+	HiZPyramid(unsigned int depthWidth, unsigned int depthHeight, bool cpuCopy = false)
+		: m_depthWidth{ depthWidth }, m_depthHeight{ depthHeight }, m_cpuCopy{ cpuCopy }
+	{
+		//Floor halving, as OpenGL does for mipmaps
+		unsigned int width = std::max(1u, depthWidth / 2), height = std::max(1u, depthHeight / 2);
+		while (true)
+		{
+			m_levelSizes.push_back({ width, height });
+			if (width == 1 && height == 1)
+				break;
+			width = std::max(1u, width / 2);
+			height = std::max(1u, height / 2);
+		}
+
+		glGenTextures(1, &m_texture);
+		glBindTexture(GL_TEXTURE_2D, m_texture);
+		for (unsigned int level = 0; level < m_levelSizes.size(); ++level)
+			glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, m_levelSizes[level].x, m_levelSizes[level].y, 0, GL_RED, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, getLevelCount() - 1);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenFramebuffers(1, &m_framebuffer);
+		glGenVertexArrays(1, &m_emptyVAO);
+		m_program = createReduceProgram();
+
+		//The CPU copy starts at the first level no larger than 128 texels wide, to keep the read back small
+		m_firstCpuLevel = 0;
+		while (m_firstCpuLevel + 1 < getLevelCount() && m_levelSizes[m_firstCpuLevel].x > 128)
+			++m_firstCpuLevel;
+		if (m_cpuCopy)
+		{
+			m_cpuLevels.resize(getLevelCount());
+			for (unsigned int level = m_firstCpuLevel; level < getLevelCount(); ++level)
+				m_cpuLevels[level].assign(m_levelSizes[level].x * m_levelSizes[level].y, 1.f);
+		}
+	}
+
+	~HiZPyramid()
+	{
+		glDeleteTextures(1, &m_texture);
+		glDeleteFramebuffers(1, &m_framebuffer);
+		glDeleteVertexArrays(1, &m_emptyVAO);
+		glDeleteProgram(m_program);
+	}
+
+	HiZPyramid(const HiZPyramid&) = delete;
+	HiZPyramid& operator=(const HiZPyramid&) = delete;
+
+	//Build the pyramid from a depth texture (compare mode must be GL_NONE) rendered with viewProjection
+	void build(unsigned int depthTexture, const glm::mat4& viewProjection)
+	{
+		GLint previousFramebuffer, previousViewport[4];
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+		glGetIntegerv(GL_VIEWPORT, previousViewport);
+		const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+		glDisable(GL_DEPTH_TEST);
+
+		glUseProgram(m_program);
+		glUniform1i(glGetUniformLocation(m_program, "source"), 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+		glBindVertexArray(m_emptyVAO);
+
+		for (unsigned int level = 0; level < getLevelCount(); ++level)
+		{
+			//Read the previous level only, writing in the current one must not be a feedback loop
+			if (level == 0)
+			{
+				glBindTexture(GL_TEXTURE_2D, depthTexture);
+			}
+			else
+			{
+				glBindTexture(GL_TEXTURE_2D, m_texture);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+			}
+
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_texture, level);
+			glViewport(0, 0, m_levelSizes[level].x, m_levelSizes[level].y);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, m_texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, getLevelCount() - 1);
+
+		if (m_cpuCopy)
+		{
+			for (unsigned int level = m_firstCpuLevel; level < getLevelCount(); ++level)
+				glGetTexImage(GL_TEXTURE_2D, level, GL_RED, GL_FLOAT, m_cpuLevels[level].data());
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glBindVertexArray(0);
+		glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+		glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+		if (depthTest)
+			glEnable(GL_DEPTH_TEST);
+
+		m_viewProjection = viewProjection;
+		m_isBuilt = true;
+	}
+
+	//Test a world space box against the CPU copy of the pyramid (requires cpuCopy). Until the first build everything is visible.
+	bool isVisible(const glm::vec3& center, const glm::vec3& extents) const
+	{
+		if (!m_isBuilt || !m_cpuCopy)
+			return true;
+
+		//Screen rectangle in [0, 1] and nearest depth of the 8 corners
+		glm::vec3 minScreen{ 1.f };
+		glm::vec3 maxScreen{ 0.f };
+		for (unsigned int i = 0; i < 8; ++i)
+		{
+			const glm::vec3 corner{ center.x + (i & 1 ? extents.x : -extents.x),
+				center.y + (i & 2 ? extents.y : -extents.y),
+				center.z + (i & 4 ? extents.z : -extents.z) };
+			const glm::vec4 clip = m_viewProjection * glm::vec4(corner, 1.f);
+			if (clip.w <= 1e-5f)
+				return true; //Crossing the near plane
+
+			const glm::vec3 screen = glm::vec3(clip) / clip.w * 0.5f + 0.5f;
+			minScreen = glm::min(minScreen, screen);
+			maxScreen = glm::max(maxScreen, screen);
+		}
+		minScreen = glm::clamp(minScreen, 0.f, 1.f);
+		maxScreen = glm::clamp(maxScreen, 0.f, 1.f);
+		if (minScreen.x >= maxScreen.x || minScreen.y >= maxScreen.y)
+			return true; //Outside the screen, the frustum culling is responsible of it
+
+		//Level where the rectangle covers about 2 * 2 texels, at least the first level copied on the CPU
+		const glm::vec2 sizeInPixels = (glm::vec2(maxScreen) - glm::vec2(minScreen)) * glm::vec2(m_depthWidth, m_depthHeight);
+		const int wantedLevel = static_cast<int>(std::ceil(std::log2(std::max(std::max(sizeInPixels.x, sizeInPixels.y), 1.f)))) - 1;
+		const unsigned int level = std::min(std::max(wantedLevel, static_cast<int>(m_firstCpuLevel)), static_cast<int>(getLevelCount()) - 1);
+
+		//Pixels of the depth buffer first: every level halves the previous one with floor and its last texel also covers
+		//the odd leftover, so a pixel is in the texel pixel >> (level + 1) clamped to the last one. Scaling the screen
+		//coordinates by the level size instead would miss that leftover at the coarse levels.
+		const glm::uvec2 depthSize{ m_depthWidth, m_depthHeight };
+		const glm::uvec2 minPixel = glm::min(glm::uvec2(glm::vec2(minScreen) * glm::vec2(depthSize)), depthSize - 1u);
+		const glm::uvec2 maxPixel = glm::min(glm::uvec2(glm::vec2(maxScreen) * glm::vec2(depthSize)), depthSize - 1u);
+		const glm::uvec2& size = m_levelSizes[level];
+		const glm::uvec2 minTexel = glm::min(minPixel >> (level + 1u), size - 1u);
+		const glm::uvec2 maxTexel = glm::min(maxPixel >> (level + 1u), size - 1u);
+		const std::vector<float>& depth = m_cpuLevels[level];
+		for (unsigned int y = minTexel.y; y <= maxTexel.y; ++y)
+		{
+			for (unsigned int x = minTexel.x; x <= maxTexel.x; ++x)
+			{
+				if (minScreen.z <= depth[y * size.x + x])
+					return true;
+			}
+		}
+		return false;
+	}
+
+	//Same test for a local space box and its model matrix
+	bool isVisible(const glm::vec3& localCenter, const glm::vec3& localExtents, const glm::mat4& model) const
+	{
+		const glm::vec3 center{ model * glm::vec4(localCenter, 1.f) };
+		const glm::vec3 extents = glm::abs(glm::vec3(model[0])) * localExtents.x +
+			glm::abs(glm::vec3(model[1])) * localExtents.y +
+			glm::abs(glm::vec3(model[2])) * localExtents.z;
+		return isVisible(center, extents);
+	}
+
+	unsigned int getTexture() const
+	{
+		return m_texture;
+	}
+
+	unsigned int getLevelCount() const
+	{
+		return static_cast<unsigned int>(m_levelSizes.size());
+	}
+
+	glm::vec2 getDepthSize() const
+	{
+		return { m_depthWidth, m_depthHeight };
+	}
+
+	//View projection the depth buffer of the last build was rendered with
+	const glm::mat4& getViewProjection() const
+	{
+		return m_viewProjection;
+	}
+
+	bool isBuilt() const
+	{
+		return m_isBuilt;
+	}
+
+protected:
+	unsigned int m_depthWidth;
+	unsigned int m_depthHeight;
+	bool m_cpuCopy;
+	bool m_isBuilt = false;
+
+	std::vector<glm::uvec2> m_levelSizes;
+	unsigned int m_firstCpuLevel;
+	std::vector<std::vector<float>> m_cpuLevels;
+	glm::mat4 m_viewProjection = glm::mat4(1.0f);
+
+	unsigned int m_texture = 0;
+	unsigned int m_framebuffer = 0;
+	unsigned int m_emptyVAO = 0;
+	unsigned int m_program = 0;
+
+protected:
+	static unsigned int createReduceProgram()
+	{
+		//Full screen triangle generated from gl_VertexID
+		const char* vertexCode =
+			"#version 330 core\n"
+			"void main()\n"
+			"{\n"
+			"    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+			"    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);\n"
+			"}\n";
+
+		//Farthest depth of the 2 * 2 source texels. On odd sizes the last row/column also takes the extra texel.
+		const char* fragmentCode =
+			"#version 330 core\n"
+			"out float farthestDepth;\n"
+			"uniform sampler2D source;\n"
+			"void main()\n"
+			"{\n"
+			"    ivec2 sourceSize = textureSize(source, 0);\n"
+			"    ivec2 texel = ivec2(gl_FragCoord.xy);\n"
+			"    ivec2 extent = ivec2(2) + ivec2(equal(texel, sourceSize / 2 - 1)) * (sourceSize & 1);\n"
+			"    float depth = 0.0;\n"
+			"    for (int y = 0; y < extent.y; ++y)\n"
+			"        for (int x = 0; x < extent.x; ++x)\n"
+			"            depth = max(depth, texelFetch(source, min(texel * 2 + ivec2(x, y), sourceSize - 1), 0).r);\n"
+			"    farthestDepth = depth;\n"
+			"}\n";
+
+		const unsigned int vertex = compileShader(GL_VERTEX_SHADER, vertexCode);
+		const unsigned int fragment = compileShader(GL_FRAGMENT_SHADER, fragmentCode);
+		const unsigned int program = glCreateProgram();
+		glAttachShader(program, vertex);
+		glAttachShader(program, fragment);
+		glLinkProgram(program);
+
+		GLint success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			GLchar infoLog[1024];
+			glGetProgramInfoLog(program, 1024, NULL, infoLog);
+			std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: HIZ\n" << infoLog << std::endl;
+		}
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+		return program;
+	}
+
+	static unsigned int compileShader(GLenum type, const char* code)
+	{
+		const unsigned int shader = glCreateShader(type);
+		glShaderSource(shader, 1, &code, NULL);
+		glCompileShader(shader);
+
+		GLint success;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			GLchar infoLog[1024];
+			glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+			std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: HIZ\n" << infoLog << std::endl;
+		}
+		return shader;
+	}
+};
+#endif
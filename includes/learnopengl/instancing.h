@@ -0,0 +1,150 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp> //glm::mat4
+#include <vector> //std::vector
+#include <map> //std::map
+#include <utility> //std::pair
+#include <algorithm> //std::max
+#include <cstddef> //offsetof
+
+#include <learnopengl/model.h>
+
+struct InstancingStats
+{
+	unsigned int instances = 0;
+	unsigned int batches = 0;
+	unsigned int drawCalls = 0;                  //Instanced draws issued
+	unsigned int drawCallsWithoutInstancing = 0; //One draw per mesh and per instance, as Model::Draw would do
+};
+
+//Group the instances by (Model, shader) and draw every group with one instanced draw per mesh.
+//The world matrices of all the groups are streamed in a single buffer, orphaned at every flush, and read by the vertex
+//shader as a mat4 attribute at locations INSTANCE_MATRIX_LOCATION to INSTANCE_MATRIX_LOCATION + 3 with divisor 1.
+//Skinned instances also get the offset of their bone palette as an int attribute at INSTANCE_PALETTE_LOCATION.
+//Locations 0 to 6 are left to the mesh (position, normal, texture coordinates, tangent, bitangent and bones).
+class InstanceBatcher
+{
+public:
+	static constexpr unsigned int INSTANCE_MATRIX_LOCATION = 7;
+	static constexpr unsigned int INSTANCE_PALETTE_LOCATION = 11;
+
+	InstanceBatcher()
+	{
+		glGenBuffers(1, &m_instanceBuffer);
+	}
+
+	~InstanceBatcher()
+	{
+		glDeleteBuffers(1, &m_instanceBuffer);
+	}
+
+	InstanceBatcher(const InstanceBatcher&) = delete;
+	InstanceBatcher& operator=(const InstanceBatcher&) = delete;
+
+	//The shader must read the model matrix from the instance attribute instead of the uniform
+	void add(Model& model, Shader& shader, const glm::mat4& modelMatrix, int paletteOffset = 0)
+	{
+		const std::pair<Model*, unsigned int> key{ &model, shader.ID };
+		auto it = m_batchIndices.find(key);
+		if (it == m_batchIndices.end())
+		{
+			it = m_batchIndices.emplace(key, m_batches.size()).first;
+			m_batches.push_back({ &model, &shader, {} });
+		}
+		m_batches[it->second].instances.push_back({ modelMatrix, paletteOffset });
+	}
+
+	//Upload the matrices added since the last flush and draw them. The groups are kept so that the next frames don't allocate.
+	void flush()
+	{
+		unsigned int instanceCount = 0;
+		for (const Batch& batch : m_batches)
+			instanceCount += static_cast<unsigned int>(batch.instances.size());
+		if (instanceCount == 0)
+			return;
+
+		//Orphan the buffer: the driver gives a new storage instead of waiting for the draws of the previous flush
+		glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+		m_capacity = std::max(m_capacity, instanceCount);
+		glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+
+		size_t offset = 0;
+		for (Batch& batch : m_batches)
+		{
+			const unsigned int amount = static_cast<unsigned int>(batch.instances.size());
+			if (amount == 0)
+				continue;
+
+			glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+			glBufferSubData(GL_ARRAY_BUFFER, offset, amount * sizeof(InstanceData), batch.instances.data());
+
+			batch.shader->use();
+			for (Mesh& mesh : batch.model->meshes)
+			{
+				setInstanceAttributes(mesh.VAO, offset);
+				mesh.DrawInstanced(*batch.shader, amount);
+				m_stats.drawCalls++;
+			}
+
+			m_stats.instances += amount;
+			m_stats.batches++;
+			m_stats.drawCallsWithoutInstancing += amount * static_cast<unsigned int>(batch.model->meshes.size());
+			offset += amount * sizeof(InstanceData);
+			batch.instances.clear();
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	//Statistics are accumulated over the flushes until reset, usually once per frame
+	const InstancingStats& getStats() const
+	{
+		return m_stats;
+	}
+
+	void resetStats()
+	{
+		m_stats = InstancingStats{};
+	}
+
+protected:
+	struct InstanceData
+	{
+		glm::mat4 modelMatrix;
+		int paletteOffset;
+	};
+
+	struct Batch
+	{
+		Model* model;
+		Shader* shader;
+		std::vector<InstanceData> instances;
+	};
+
+	//Point the instance attributes of the VAO at the instances of the batch, starting offset bytes in the instance buffer
+	void setInstanceAttributes(unsigned int VAO, size_t offset)
+	{
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+		for (unsigned int column = 0; column < 4; ++column)
+		{
+			const unsigned int location = INSTANCE_MATRIX_LOCATION + column;
+			glEnableVertexAttribArray(location);
+			glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + column * sizeof(glm::vec4)));
+			glVertexAttribDivisor(location, 1);
+		}
+		glEnableVertexAttribArray(INSTANCE_PALETTE_LOCATION);
+		glVertexAttribIPointer(INSTANCE_PALETTE_LOCATION, 1, GL_INT, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, paletteOffset)));
+		glVertexAttribDivisor(INSTANCE_PALETTE_LOCATION, 1);
+		glBindVertexArray(0);
+	}
+
+	std::vector<Batch> m_batches;
+	std::map<std::pair<Model*, unsigned int>, size_t> m_batchIndices;
+
+	unsigned int m_instanceBuffer = 0;
+	unsigned int m_capacity = 0; //In instances
+	InstancingStats m_stats;
+};
+#endif
@@ -12,6 +12,8 @@
 #include <vector>
 using namespace std;
 
+#define MAX_BONE_WEIGHTS 4
+
 struct Vertex {
     // position
     glm::vec3 Position;
@@ -23,6 +25,10 @@ struct Vertex {
     glm::vec3 Tangent;
     // bitangent
     glm::vec3 Bitangent;
+    // bone indexes which will influence this vertex (-1 when unused)
+    int m_BoneIDs[MAX_BONE_WEIGHTS];
+    // weights from each bone
+    float m_Weights[MAX_BONE_WEIGHTS];
 };
 
 struct Texture {
@@ -54,6 +60,38 @@ public:
     void Draw(Shader &shader) 
     {
         // bind appropriate textures
+        bindTextures(shader);
+        
+        // draw mesh
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // render the mesh amount times, the per instance attributes must already be set on the VAO
+    void DrawInstanced(Shader &shader, unsigned int amount)
+    {
+        bindTextures(shader);
+
+        glBindVertexArray(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, amount);
+        glBindVertexArray(0);
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // element buffer of the mesh, to draw the same triangles from other vertex arrays (e.g. pre-skinned vertices)
+    unsigned int getElementBuffer() const
+    {
+        return EBO;
+    }
+
+    // bind the textures of the mesh to the samplers named after their type (texture_diffuseN, texture_specularN, ...)
+    void bindTextures(Shader &shader)
+    {
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
@@ -78,14 +116,6 @@ public:
             // and finally bind the texture
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
-        
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
     }
 
 private:
@@ -127,6 +157,12 @@ private:
         // vertex bitangent
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        // bone ids (integer attribute)
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, MAX_BONE_WEIGHTS, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
+        // bone weights
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, MAX_BONE_WEIGHTS, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
 
         glBindVertexArray(0);
     }
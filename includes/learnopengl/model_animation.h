@@ -41,6 +41,41 @@ public:
         loadModel(path);
     }
 
+    // empty model, filled later by loadScene or by an AnimationLibrary
+    Model() : gammaCorrection(false)
+    {
+    }
+
+    // processes a scene already imported (e.g. shared with the animation clips); path is the file it was read from
+    void loadScene(const aiScene* scene, string const &path)
+    {
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        // process ASSIMP's root node recursively
+        processNode(scene->mRootNode, scene);
+    }
+
+    // loads a texture of the model directory once, for meshes that don't come from an aiMaterial
+    Texture loadTexture(string const &path, string const &typeName)
+    {
+        for(unsigned int j = 0; j < textures_loaded.size(); j++)
+        {
+            if(textures_loaded[j].path == path)
+            {
+                Texture texture = textures_loaded[j];
+                texture.type = typeName;
+                return texture;
+            }
+        }
+        Texture texture;
+        texture.id = TextureFromFile(path.c_str(), this->directory);
+        texture.type = typeName;
+        texture.path = path;
+        textures_loaded.push_back(texture);
+        return texture;
+    }
+
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
@@ -69,11 +104,7 @@ private:
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
-
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        loadScene(scene, path);
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
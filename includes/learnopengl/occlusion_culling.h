@@ -0,0 +1,351 @@
+#ifndef OCCLUSION_CULLING_H
+#define OCCLUSION_CULLING_H
+
+#include <glm/glm.hpp> //glm::mat4
+#include <vector> //std::vector
+#include <array> //std::array
+#include <chrono> //std::chrono::high_resolution_clock
+#include <algorithm> //std::min, std::max
+#include <limits> //std::numeric_limits
+#include <cmath> //std::floor, std::ceil
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_CULLING_SSE
+#include <emmintrin.h> //__m128
+#endif
+
+//Triangle soup used as occluder. Keep it small and fully inside the object it stands for (a simplified hull),
+//otherwise objects behind its silhouette could be wrongly rejected.
+struct OccluderMesh
+{
+	std::vector<glm::vec3> vertices;
+	std::vector<unsigned int> indices;
+
+	//Box of half size "extents" around "center". To occlude for a sphere use the inscribed box (radius / sqrt(3))
+	static OccluderMesh createBox(const glm::vec3& center, const glm::vec3& extents)
+	{
+		OccluderMesh box;
+		for (unsigned int i = 0; i < 8; ++i)
+		{
+			box.vertices.push_back({ center.x + (i & 1 ? extents.x : -extents.x),
+				center.y + (i & 2 ? extents.y : -extents.y),
+				center.z + (i & 4 ? extents.z : -extents.z) });
+		}
+
+		box.indices = {
+			0, 2, 1, 1, 2, 3, // -z
+			4, 5, 6, 5, 7, 6, // +z
+			0, 4, 2, 2, 4, 6, // -x
+			1, 3, 5, 3, 7, 5, // +x
+			0, 1, 4, 1, 5, 4, // -y
+			2, 6, 3, 3, 6, 7  // +y
+		};
+		return box;
+	}
+};
+
+struct OcclusionStats
+{
+	unsigned int occluderTriangles = 0; //Triangles rasterized in the depth buffer
+	unsigned int tested = 0;            //Bounding boxes tested against the depth buffer
+	unsigned int occluded = 0;          //Bounding boxes rejected
+	float rasterTimeMs = 0.f;           //Time spent to render the occluders
+	float testTimeMs = 0.f;             //Time spent to test the bounding boxes
+};
+
+//CPU software occlusion culling.
+//Occluders are rasterized in a low resolution depth buffer, 4 pixels at a time with SSE. The buffer is split in tiles of
+//TILE_WIDTH * TILE_HEIGHT pixels and each tile keep the farthest depth of its pixels. A bounding box is occluded where
+//its nearest depth is behind the tile depth, so most of the tests never look at the pixels.
+//Depth is stored in [0, 1], 0 on the near plane and 1 on the far plane (or where nothing was rasterized).
+class OcclusionCuller
+{
+public:
+	static const unsigned int TILE_WIDTH = 8;
+	static const unsigned int TILE_HEIGHT = 4;
+
+	//Width must be a multiple of TILE_WIDTH and height a multiple of TILE_HEIGHT
+	OcclusionCuller(unsigned int width = 256, unsigned int height = 128)
+		: m_width{ width }, m_height{ height },
+		m_tilesX{ width / TILE_WIDTH }, m_tilesY{ height / TILE_HEIGHT },
+		m_depth(width * height, 1.f), m_tileMaxDepth(m_tilesX * m_tilesY, 1.f)
+	{}
+
+	//Clear the depth buffer and the statistics. Must be called before rendering the occluders of a new frame.
+	void beginFrame(const glm::mat4& viewProjection)
+	{
+		m_viewProjection = viewProjection;
+		m_stats = OcclusionStats{};
+		std::fill(m_depth.begin(), m_depth.end(), 1.f);
+		std::fill(m_tileMaxDepth.begin(), m_tileMaxDepth.end(), 1.f);
+	}
+
+	void renderOccluder(const OccluderMesh& occluder, const glm::mat4& modelMatrix)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		const glm::mat4 mvp = m_viewProjection * modelMatrix;
+		m_screenVertices.resize(occluder.vertices.size());
+		for (size_t i = 0; i < occluder.vertices.size(); ++i)
+			m_screenVertices[i] = mvp * glm::vec4(occluder.vertices[i], 1.f);
+
+		for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3)
+		{
+			const glm::vec4& v0 = m_screenVertices[occluder.indices[i]];
+			const glm::vec4& v1 = m_screenVertices[occluder.indices[i + 1]];
+			const glm::vec4& v2 = m_screenVertices[occluder.indices[i + 2]];
+
+			//No clipping: triangles crossing the near plane are skipped. Not rasterizing an occluder is always conservative.
+			if (v0.w <= s_minW || v1.w <= s_minW || v2.w <= s_minW)
+				continue;
+
+			rasterizeTriangle(toScreen(v0), toScreen(v1), toScreen(v2));
+		}
+
+		m_stats.rasterTimeMs += elapsedMs(start);
+	}
+
+	//Build the tile level of the depth buffer. Must be called once all the occluders of the frame are rendered.
+	void endOccluders()
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		for (unsigned int ty = 0; ty < m_tilesY; ++ty)
+		{
+			for (unsigned int tx = 0; tx < m_tilesX; ++tx)
+			{
+				const float* row = &m_depth[ty * TILE_HEIGHT * m_width + tx * TILE_WIDTH];
+#ifdef OCCLUSION_CULLING_SSE
+				__m128 maxDepth = _mm_setzero_ps();
+				for (unsigned int y = 0; y < TILE_HEIGHT; ++y, row += m_width)
+				{
+					for (unsigned int x = 0; x < TILE_WIDTH; x += 4)
+						maxDepth = _mm_max_ps(maxDepth, _mm_loadu_ps(row + x));
+				}
+				maxDepth = _mm_max_ps(maxDepth, _mm_shuffle_ps(maxDepth, maxDepth, _MM_SHUFFLE(1, 0, 3, 2)));
+				maxDepth = _mm_max_ps(maxDepth, _mm_shuffle_ps(maxDepth, maxDepth, _MM_SHUFFLE(2, 3, 0, 1)));
+				m_tileMaxDepth[ty * m_tilesX + tx] = _mm_cvtss_f32(maxDepth);
+#else
+				float maxDepth = 0.f;
+				for (unsigned int y = 0; y < TILE_HEIGHT; ++y, row += m_width)
+				{
+					for (unsigned int x = 0; x < TILE_WIDTH; ++x)
+						maxDepth = std::max(maxDepth, row[x]);
+				}
+				m_tileMaxDepth[ty * m_tilesX + tx] = maxDepth;
+#endif
+			}
+		}
+
+		m_stats.rasterTimeMs += elapsedMs(start);
+	}
+
+	//Return false if the world space box is hidden behind the occluders. Box crossing the near plane or outside the
+	//screen are always considered as visible: the frustum culling is responsible of them.
+	bool testAABB(const glm::vec3& center, const glm::vec3& extents)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		const bool visible = isAABBVisible(center, extents);
+
+		++m_stats.tested;
+		if (!visible)
+			++m_stats.occluded;
+		m_stats.testTimeMs += elapsedMs(start);
+		return visible;
+	}
+
+	const OcclusionStats& getStats() const
+	{
+		return m_stats;
+	}
+
+	unsigned int getWidth() const
+	{
+		return m_width;
+	}
+
+	unsigned int getHeight() const
+	{
+		return m_height;
+	}
+
+	//Depth of a pixel, row 0 is the bottom of the screen
+	float getDepth(unsigned int x, unsigned int y) const
+	{
+		return m_depth[y * m_width + x];
+	}
+
+protected:
+	static constexpr float s_minW = 1e-5f;
+
+	unsigned int m_width;
+	unsigned int m_height;
+	unsigned int m_tilesX;
+	unsigned int m_tilesY;
+
+	std::vector<float> m_depth;
+	std::vector<float> m_tileMaxDepth;
+	std::vector<glm::vec4> m_screenVertices; //Scratch buffer reused between occluders
+
+	glm::mat4 m_viewProjection = glm::mat4(1.0f);
+	OcclusionStats m_stats;
+
+protected:
+	static float elapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//Clip space to pixel coordinates and depth in [0, 1]
+	glm::vec3 toScreen(const glm::vec4& clip) const
+	{
+		const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		return { (ndc.x * 0.5f + 0.5f) * m_width, (ndc.y * 0.5f + 0.5f) * m_height, ndc.z * 0.5f + 0.5f };
+	}
+
+	void rasterizeTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2)
+	{
+		//Occluders are double sided: flip the back facing triangles so the edge functions are positive inside
+		float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+		if (area == 0.f)
+			return;
+		if (area < 0.f)
+		{
+			std::swap(v1, v2);
+			area = -area;
+		}
+
+		//Bounding rectangle in pixels, x aligned on the SIMD width. Pixels are sampled at their center.
+		const int minX = std::max(0, static_cast<int>(std::floor(std::min({ v0.x, v1.x, v2.x })))) & ~3;
+		const int maxX = std::min(static_cast<int>(m_width) - 1, static_cast<int>(std::ceil(std::max({ v0.x, v1.x, v2.x }))));
+		const int minY = std::max(0, static_cast<int>(std::floor(std::min({ v0.y, v1.y, v2.y }))));
+		const int maxY = std::min(static_cast<int>(m_height) - 1, static_cast<int>(std::ceil(std::max({ v0.y, v1.y, v2.y }))));
+		if (minX > maxX || minY > maxY)
+			return;
+
+		++m_stats.occluderTriangles;
+
+		//Edge functions e(x, y) = a * x + b * y + c, positive on the inner side of the edge
+		const std::array<glm::vec3, 3> vertices = { v0, v1, v2 };
+		std::array<float, 3> a, b, c;
+		for (unsigned int i = 0; i < 3; ++i)
+		{
+			const glm::vec3& p = vertices[i];
+			const glm::vec3& q = vertices[(i + 1) % 3];
+			a[i] = p.y - q.y;
+			b[i] = q.x - p.x;
+			c[i] = p.x * q.y - p.y * q.x;
+		}
+
+		//Depth plane z(x, y) = zA * x + zB * y + zC. The edge function of the opposite edge is the barycentric weight.
+		const float invArea = 1.f / area;
+		const float zA = (a[1] * v0.z + a[2] * v1.z + a[0] * v2.z) * invArea;
+		const float zB = (b[1] * v0.z + b[2] * v1.z + b[0] * v2.z) * invArea;
+		const float zC = (c[1] * v0.z + c[2] * v1.z + c[0] * v2.z) * invArea;
+
+#ifdef OCCLUSION_CULLING_SSE
+		const __m128 pixelOffset = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 a0 = _mm_set1_ps(a[0]), a1 = _mm_set1_ps(a[1]), a2 = _mm_set1_ps(a[2]);
+		const __m128 zAv = _mm_set1_ps(zA);
+
+		for (int y = minY; y <= maxY; ++y)
+		{
+			const float pixelY = y + 0.5f;
+			const __m128 rowE0 = _mm_set1_ps(b[0] * pixelY + c[0]);
+			const __m128 rowE1 = _mm_set1_ps(b[1] * pixelY + c[1]);
+			const __m128 rowE2 = _mm_set1_ps(b[2] * pixelY + c[2]);
+			const __m128 rowZ = _mm_set1_ps(zB * pixelY + zC);
+			float* row = &m_depth[y * m_width];
+
+			for (int x = minX; x <= maxX; x += 4)
+			{
+				const __m128 pixelX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), pixelOffset);
+				const __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, pixelX), rowE0);
+				const __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, pixelX), rowE1);
+				const __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, pixelX), rowE2);
+				const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+				if (_mm_movemask_ps(inside) == 0)
+					continue;
+
+				const __m128 z = _mm_add_ps(_mm_mul_ps(zAv, pixelX), rowZ);
+				const __m128 previous = _mm_loadu_ps(row + x);
+				const __m128 nearest = _mm_min_ps(previous, z);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, previous)));
+			}
+		}
+#else
+		for (int y = minY; y <= maxY; ++y)
+		{
+			const float pixelY = y + 0.5f;
+			float* row = &m_depth[y * m_width];
+
+			for (int x = minX; x <= maxX; ++x)
+			{
+				const float pixelX = x + 0.5f;
+				if (a[0] * pixelX + b[0] * pixelY + c[0] < 0.f ||
+					a[1] * pixelX + b[1] * pixelY + c[1] < 0.f ||
+					a[2] * pixelX + b[2] * pixelY + c[2] < 0.f)
+					continue;
+
+				row[x] = std::min(row[x], zA * pixelX + zB * pixelY + zC);
+			}
+		}
+#endif
+	}
+
+	bool isAABBVisible(const glm::vec3& center, const glm::vec3& extents) const
+	{
+		//Screen rectangle and nearest depth of the 8 corners
+		glm::vec2 minScreen{ std::numeric_limits<float>::max() };
+		glm::vec2 maxScreen{ std::numeric_limits<float>::lowest() };
+		float minDepth = std::numeric_limits<float>::max();
+		for (unsigned int i = 0; i < 8; ++i)
+		{
+			const glm::vec3 corner{ center.x + (i & 1 ? extents.x : -extents.x),
+				center.y + (i & 2 ? extents.y : -extents.y),
+				center.z + (i & 4 ? extents.z : -extents.z) };
+			const glm::vec4 clip = m_viewProjection * glm::vec4(corner, 1.f);
+			if (clip.w <= s_minW)
+				return true;
+
+			const glm::vec3 screen = toScreen(clip);
+			minScreen = glm::min(minScreen, glm::vec2(screen));
+			maxScreen = glm::max(maxScreen, glm::vec2(screen));
+			minDepth = std::min(minDepth, screen.z);
+		}
+
+		const int minX = std::max(0, static_cast<int>(std::floor(minScreen.x)));
+		const int maxX = std::min(static_cast<int>(m_width) - 1, static_cast<int>(std::ceil(maxScreen.x)));
+		const int minY = std::max(0, static_cast<int>(std::floor(minScreen.y)));
+		const int maxY = std::min(static_cast<int>(m_height) - 1, static_cast<int>(std::ceil(maxScreen.y)));
+		if (minX > maxX || minY > maxY)
+			return true;
+
+		for (int ty = minY / TILE_HEIGHT; ty <= maxY / static_cast<int>(TILE_HEIGHT); ++ty)
+		{
+			for (int tx = minX / TILE_WIDTH; tx <= maxX / static_cast<int>(TILE_WIDTH); ++tx)
+			{
+				//The whole tile is in front of the box
+				if (minDepth >= m_tileMaxDepth[ty * m_tilesX + tx])
+					continue;
+
+				//Otherwise check the pixels of the tile covered by the box
+				const int startX = std::max(minX, tx * static_cast<int>(TILE_WIDTH));
+				const int endX = std::min(maxX, (tx + 1) * static_cast<int>(TILE_WIDTH) - 1);
+				const int startY = std::max(minY, ty * static_cast<int>(TILE_HEIGHT));
+				const int endY = std::min(maxY, (ty + 1) * static_cast<int>(TILE_HEIGHT) - 1);
+				for (int y = startY; y <= endY; ++y)
+				{
+					for (int x = startX; x <= endX; ++x)
+					{
+						if (minDepth < m_depth[y * m_width + x])
+							return true;
+					}
+				}
+			}
+		}
+		return false;
+	}
+};
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <learnopengl/animation.h>
+
+/*
+	Final bone matrices of a clip sampled at a fixed rate, for characters that don't
+	need exact keyframe evaluation. Playing from the cache is a blend of two samples
+	per bone: no key search, no hierarchy walk.
+
+	The last row of a skinning matrix is always (0, 0, 0, 1), so each matrix is stored
+	as its three first rows (48 bytes instead of 64). Samples cover [0, duration]
+	inclusively so looping blends toward the exact end pose.
+*/
+class PoseCache
+{
+public:
+	// samplesPerSecond is in seconds of playback, not in animation ticks
+	PoseCache(Animation* animation, float samplesPerSecond)
+		: m_Animation(animation)
+	{
+		m_BoneCount = 0;
+		for (const auto& boneInfo : animation->GetBoneIDMap())
+			m_BoneCount = std::max(m_BoneCount, boneInfo.second.id + 1);
+
+		const float seconds = animation->GetDuration() / animation->GetTicksPerSecond();
+		m_FrameCount = std::max(2, static_cast<int>(std::ceil(seconds * samplesPerSecond)) + 1);
+		m_Rows.resize((size_t)m_FrameCount * m_BoneCount * 3);
+
+		// live evaluation of every sample, in order so that the key cursors only move forward
+		std::vector<BoneCursor> cursors;
+		std::vector<glm::mat4> globalTransforms;
+		std::vector<glm::mat4> pose(m_BoneCount, glm::mat4(1.0f));
+		for (int frame = 0; frame < m_FrameCount; ++frame)
+		{
+			animation->EvaluatePose(animation->GetDuration() * frame / (m_FrameCount - 1), cursors, globalTransforms, pose.data());
+			glm::vec4* rows = &m_Rows[(size_t)frame * m_BoneCount * 3];
+			for (int bone = 0; bone < m_BoneCount; ++bone)
+			{
+				const glm::mat4 transposed = glm::transpose(pose[bone]);
+				rows[bone * 3] = transposed[0];
+				rows[bone * 3 + 1] = transposed[1];
+				rows[bone * 3 + 2] = transposed[2];
+			}
+		}
+	}
+
+	// writes the blended pose at animationTime (in ticks) for every bone id of the clip
+	void Sample(float animationTime, glm::mat4* pose) const
+	{
+		float frame = animationTime / m_Animation->GetDuration() * (m_FrameCount - 1);
+		frame = glm::clamp(frame, 0.0f, (float)(m_FrameCount - 1));
+		const int frame0 = std::min(static_cast<int>(frame), m_FrameCount - 2);
+		const float factor = frame - frame0;
+
+		const glm::vec4* rows0 = &m_Rows[(size_t)frame0 * m_BoneCount * 3];
+		const glm::vec4* rows1 = rows0 + m_BoneCount * 3;
+		for (int bone = 0; bone < m_BoneCount; ++bone)
+		{
+			const glm::vec4 row0 = glm::mix(rows0[bone * 3], rows1[bone * 3], factor);
+			const glm::vec4 row1 = glm::mix(rows0[bone * 3 + 1], rows1[bone * 3 + 1], factor);
+			const glm::vec4 row2 = glm::mix(rows0[bone * 3 + 2], rows1[bone * 3 + 2], factor);
+			glm::mat4& matrix = pose[bone];
+			matrix[0] = glm::vec4(row0.x, row1.x, row2.x, 0.0f);
+			matrix[1] = glm::vec4(row0.y, row1.y, row2.y, 0.0f);
+			matrix[2] = glm::vec4(row0.z, row1.z, row2.z, 0.0f);
+			matrix[3] = glm::vec4(row0.w, row1.w, row2.w, 1.0f);
+		}
+	}
+
+	Animation* GetAnimation() const { return m_Animation; }
+	int GetFrameCount() const { return m_FrameCount; }
+	int GetBoneCount() const { return m_BoneCount; }
+	size_t GetMemorySize() const { return m_Rows.size() * sizeof(glm::vec4); }
+
+private:
+	Animation* m_Animation;
+	int m_FrameCount;
+	int m_BoneCount;
+	std::vector<glm::vec4> m_Rows; // per frame, per bone id: the three first rows of the matrix
+};
+
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <learnopengl/animator.h>
+#include <learnopengl/bone_palette.h>
+
+/*
+	Deduplicates the poses of a crowd: characters playing the same clip with times
+	in the same bucket of timeStep seconds share one evaluated pose, written once
+	in the palette buffer. Every character then draws with the palette of its
+	bucket (GetPaletteIndex) instead of a palette of its own.
+
+	A crowd spread over groupCount phases (AssignPhaseGroups) costs groupCount
+	evaluations per frame whatever its size. The shared pose is the pose of the
+	first character of the bucket, the others are off by less than timeStep.
+	It is evaluated at full detail whatever the level of detail of that first
+	character, as nearby characters may draw with it: sharing replaces the
+	level of detail of the animators.
+*/
+class PoseSharing
+{
+public:
+	PoseSharing(float timeStep = 1.0f / 60.0f)
+		: m_TimeStep(timeStep)
+	{
+	}
+
+	// advances count animators by dt and writes one pose per (clip, time bucket) in the palettes 0 to
+	// GetEvaluationCount() - 1 of the mapped palette buffer (nothing is written if the map failed)
+	void UpdateAnimations(Animator* animators, int count, float dt, BonePaletteBuffer& palette)
+	{
+		m_PaletteIndices.resize(count);
+		m_Buckets.clear();
+		m_Clips.clear();
+		m_EvaluationCount = 0;
+
+		for (int i = 0; i < count; ++i)
+		{
+			Animator& animator = animators[i];
+			animator.AdvanceTime(dt);
+			const Animation* clip = animator.GetCurrentAnimation();
+			if (!clip)
+			{
+				m_PaletteIndices[i] = -1;
+				continue;
+			}
+
+			// few clips per crowd: a linear search gives each one a small index for the key
+			const size_t clipIndex = std::find(m_Clips.begin(), m_Clips.end(), clip) - m_Clips.begin();
+			if (clipIndex == m_Clips.size())
+				m_Clips.push_back(clip);
+			const float seconds = animator.GetCurrentTime() / clip->GetTicksPerSecond();
+			const uint64_t bucket = static_cast<uint64_t>(static_cast<uint32_t>(std::floor(seconds / m_TimeStep)));
+			const uint64_t key = (static_cast<uint64_t>(clipIndex) << 32) | bucket;
+
+			auto shared = m_Buckets.find(key);
+			if (shared == m_Buckets.end())
+			{
+				shared = m_Buckets.emplace(key, m_EvaluationCount++).first;
+				if (palette.IsMapped())
+				{
+					if (palette.GetFormat() == BONE_PALETTE_DUAL_QUATERNIONS)
+						animator.CalculateBoneTransforms(palette.GetDualQuaternionPalette(shared->second), 0);
+					else
+						animator.CalculateBoneTransforms(palette.GetPalette(shared->second), 0);
+				}
+			}
+			m_PaletteIndices[i] = shared->second;
+		}
+	}
+
+	// palette holding the pose of the character after the last update (-1 without animation)
+	int GetPaletteIndex(int character) const { return m_PaletteIndices[character]; }
+	// poses evaluated by the last update
+	int GetEvaluationCount() const { return m_EvaluationCount; }
+
+	float GetTimeStep() const { return m_TimeStep; }
+	void SetTimeStep(float timeStep) { m_TimeStep = timeStep; }
+
+	// puts the animators in groupCount groups evenly spread over their clip, the characters of a group playing in lockstep
+	static void AssignPhaseGroups(Animator* animators, int count, int groupCount)
+	{
+		groupCount = std::max(1, groupCount);
+		for (int i = 0; i < count; ++i)
+		{
+			const Animation* clip = animators[i].GetCurrentAnimation();
+			if (clip)
+				animators[i].SetCurrentTime(clip->GetDuration() * (i % groupCount) / groupCount);
+		}
+	}
+
+private:
+	float m_TimeStep;
+	int m_EvaluationCount = 0;
+	std::vector<int> m_PaletteIndices;
+	std::vector<const Animation*> m_Clips;
+	std::unordered_map<uint64_t, int> m_Buckets; // (clip index, time bucket) to palette
+};
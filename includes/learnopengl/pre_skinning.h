@@ -0,0 +1,354 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <cstddef>
+#include <learnopengl/model_animation.h>
+#include <learnopengl/bone_palette.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PRE_SKINNING_SSE
+#include <xmmintrin.h>
+#endif
+
+// skinned vertex in world space, laid out like the interleaved transform feedback outputs of the skinning shader
+struct PreSkinnedVertex
+{
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::vec2 TexCoords;
+	glm::vec3 Tangent;
+};
+
+/*
+	CPU skinning of count vertices with the bone matrices of pose, followed by the
+	model matrix, with the same rules as the skinning shaders: bone ids of -1 are
+	ignored and a bone id out of the pose leaves the vertex unskinned. Normals are
+	normalized, tangents are left to the passes that use them.
+
+	The model matrix is applied to the bones once, then every vertex blends its bone
+	matrices and transforms its position, normal and tangent with 4 wide SSE
+	operations when the compiler targets SSE (plain glm otherwise).
+*/
+inline void SkinVertices(const Vertex* vertices, int count, const glm::mat4* pose, int boneCount, const glm::mat4& model, PreSkinnedVertex* out)
+{
+	glm::mat4 bones[MAX_BONES];
+	boneCount = std::min(boneCount, MAX_BONES);
+	for (int bone = 0; bone < boneCount; ++bone)
+		bones[bone] = model * pose[bone];
+
+	for (int v = 0; v < count; ++v)
+	{
+		const Vertex& vertex = vertices[v];
+#ifdef PRE_SKINNING_SSE
+		__m128 column0 = _mm_setzero_ps(), column1 = _mm_setzero_ps(), column2 = _mm_setzero_ps(), column3 = _mm_setzero_ps();
+		for (int i = 0; i < MAX_BONE_WEIGHTS; ++i)
+		{
+			const int boneId = vertex.m_BoneIDs[i];
+			if (boneId == -1)
+				continue;
+			if (boneId >= boneCount)
+			{
+				column0 = _mm_loadu_ps(&model[0][0]);
+				column1 = _mm_loadu_ps(&model[1][0]);
+				column2 = _mm_loadu_ps(&model[2][0]);
+				column3 = _mm_loadu_ps(&model[3][0]);
+				break;
+			}
+			const float* matrix = &bones[boneId][0][0];
+			const __m128 weight = _mm_set1_ps(vertex.m_Weights[i]);
+			column0 = _mm_add_ps(column0, _mm_mul_ps(_mm_loadu_ps(matrix), weight));
+			column1 = _mm_add_ps(column1, _mm_mul_ps(_mm_loadu_ps(matrix + 4), weight));
+			column2 = _mm_add_ps(column2, _mm_mul_ps(_mm_loadu_ps(matrix + 8), weight));
+			column3 = _mm_add_ps(column3, _mm_mul_ps(_mm_loadu_ps(matrix + 12), weight));
+		}
+
+		const glm::vec3& p = vertex.Position;
+		const glm::vec3& n = vertex.Normal;
+		const glm::vec3& t = vertex.Tangent;
+		const __m128 position = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(p.x)), _mm_mul_ps(column1, _mm_set1_ps(p.y))),
+			_mm_add_ps(_mm_mul_ps(column2, _mm_set1_ps(p.z)), column3));
+		__m128 normal = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(n.x)), _mm_mul_ps(column1, _mm_set1_ps(n.y))),
+			_mm_mul_ps(column2, _mm_set1_ps(n.z)));
+		const __m128 tangent = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(t.x)), _mm_mul_ps(column1, _mm_set1_ps(t.y))),
+			_mm_mul_ps(column2, _mm_set1_ps(t.z)));
+
+		// the w of normal is 0: a 4 wide dot product is the squared length of the 3 components
+		__m128 lengthSquared = _mm_mul_ps(normal, normal);
+		lengthSquared = _mm_add_ps(lengthSquared, _mm_shuffle_ps(lengthSquared, lengthSquared, _MM_SHUFFLE(2, 3, 0, 1)));
+		lengthSquared = _mm_add_ps(lengthSquared, _mm_shuffle_ps(lengthSquared, lengthSquared, _MM_SHUFFLE(1, 0, 3, 2)));
+		if (_mm_cvtss_f32(lengthSquared) > 0.0f)
+			normal = _mm_div_ps(normal, _mm_sqrt_ps(lengthSquared));
+
+		float result[12];
+		_mm_storeu_ps(result, position);
+		_mm_storeu_ps(result + 4, normal);
+		_mm_storeu_ps(result + 8, tangent);
+		out[v].Position = glm::vec3(result[0], result[1], result[2]);
+		out[v].Normal = glm::vec3(result[4], result[5], result[6]);
+		out[v].Tangent = glm::vec3(result[8], result[9], result[10]);
+#else
+		glm::mat4 skin(0.0f);
+		for (int i = 0; i < MAX_BONE_WEIGHTS; ++i)
+		{
+			const int boneId = vertex.m_BoneIDs[i];
+			if (boneId == -1)
+				continue;
+			if (boneId >= boneCount)
+			{
+				skin = model;
+				break;
+			}
+			skin += bones[boneId] * vertex.m_Weights[i];
+		}
+		out[v].Position = glm::vec3(skin * glm::vec4(vertex.Position, 1.0f));
+		const glm::vec3 normal = glm::mat3(skin) * vertex.Normal;
+		const float length = glm::length(normal);
+		out[v].Normal = length > 0.0f ? normal / length : normal;
+		out[v].Tangent = glm::mat3(skin) * vertex.Tangent;
+#endif
+		out[v].TexCoords = vertex.TexCoords;
+	}
+}
+
+/*
+	Skins the meshes of a model once per frame for a whole crowd, so that every pass
+	of the frame (shadow, depth prepass, G-buffer, main...) draws the characters as
+	static geometry instead of skinning them again in its vertex shader.
+
+	Each mesh gets an output buffer holding maxCharacters copies of its vertices in
+	world space. On the GPU they are written by transform feedback (GL 3.3): one
+	instanced draw of points per mesh with the rasterizer off, the skinning shader
+	reading the palettes of a texture buffer BonePaletteBuffer and the model matrices
+	of a texture buffer of its own. SkinOnCPU fills the same buffers with SkinVertices.
+
+	Draw binds the textures of each mesh and draws all the characters with one
+	glMultiDrawElementsBaseVertex, character i starting at vertex i * vertexCount.
+	The vertex shader of the passes reads the position at location 0, the normal
+	at 1, the texture coordinates at 2 and the tangent at 3, already in world space.
+*/
+class PreSkinnedCrowd
+{
+public:
+	// skinningShaderPath: vertex shader writing outPosition, outNormal, outTexCoords and outTangent.
+	// modelTextureUnit is where the model matrices are bound during the skinning, away from the palettes and the materials.
+	PreSkinnedCrowd(Model& model, int maxCharacters, const char* skinningShaderPath, unsigned int modelTextureUnit = 9)
+		: m_Model(&model), m_MaxCharacters(maxCharacters), m_ModelTextureUnit(modelTextureUnit)
+	{
+		m_Program = CreateSkinningProgram(skinningShaderPath);
+
+		glGenBuffers(1, &m_ModelBuffer);
+		glBindBuffer(GL_TEXTURE_BUFFER, m_ModelBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, maxCharacters * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+		glGenTextures(1, &m_ModelTexture);
+		glBindTexture(GL_TEXTURE_BUFFER, m_ModelTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_ModelBuffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		for (const Mesh& mesh : model.meshes)
+		{
+			MeshOutput output;
+			output.vertexCount = static_cast<int>(mesh.vertices.size());
+			glGenBuffers(1, &output.buffer);
+			glBindBuffer(GL_ARRAY_BUFFER, output.buffer);
+			glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)maxCharacters * output.vertexCount * sizeof(PreSkinnedVertex), NULL, GL_DYNAMIC_COPY);
+
+			// the skinned vertices with the triangles of the mesh
+			glGenVertexArrays(1, &output.vertexArray);
+			glBindVertexArray(output.vertexArray);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PreSkinnedVertex), (void*)offsetof(PreSkinnedVertex, Position));
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(PreSkinnedVertex), (void*)offsetof(PreSkinnedVertex, Normal));
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(PreSkinnedVertex), (void*)offsetof(PreSkinnedVertex, TexCoords));
+			glEnableVertexAttribArray(3);
+			glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(PreSkinnedVertex), (void*)offsetof(PreSkinnedVertex, Tangent));
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.getElementBuffer());
+			glBindVertexArray(0);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+			output.counts.assign(maxCharacters, static_cast<GLsizei>(mesh.indices.size()));
+			output.indices.assign(maxCharacters, nullptr);
+			output.baseVertices.resize(maxCharacters);
+			for (int i = 0; i < maxCharacters; ++i)
+				output.baseVertices[i] = i * output.vertexCount;
+			m_Outputs.push_back(output);
+		}
+	}
+
+	~PreSkinnedCrowd()
+	{
+		for (MeshOutput& output : m_Outputs)
+		{
+			glDeleteVertexArrays(1, &output.vertexArray);
+			glDeleteBuffers(1, &output.buffer);
+		}
+		glDeleteTextures(1, &m_ModelTexture);
+		glDeleteBuffers(1, &m_ModelBuffer);
+		glDeleteProgram(m_Program);
+	}
+
+	PreSkinnedCrowd(const PreSkinnedCrowd&) = delete;
+	PreSkinnedCrowd& operator=(const PreSkinnedCrowd&) = delete;
+
+	// GPU skinning of the count first characters, character i with palette i of the current frame of palette
+	// (a texture buffer BonePaletteBuffer, after its EndFrame) and with modelMatrices[i]
+	void Skin(const glm::mat4* modelMatrices, int count, BonePaletteBuffer& palette)
+	{
+		m_CharacterCount = std::min(count, m_MaxCharacters);
+		if (m_CharacterCount <= 0)
+			return;
+
+		glBindBuffer(GL_TEXTURE_BUFFER, m_ModelBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, m_MaxCharacters * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, m_CharacterCount * sizeof(glm::mat4), modelMatrices);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		palette.AttachShader(m_Program);
+		glUseProgram(m_Program);
+		glUniform1i(glGetUniformLocation(m_Program, "bonesPerCharacter"), palette.GetBonesPerCharacter());
+		glUniform1i(glGetUniformLocation(m_Program, "modelMatrices"), m_ModelTextureUnit);
+		palette.BindFrame();
+		glActiveTexture(GL_TEXTURE0 + m_ModelTextureUnit);
+		glBindTexture(GL_TEXTURE_BUFFER, m_ModelTexture);
+		glActiveTexture(GL_TEXTURE0);
+
+		glEnable(GL_RASTERIZER_DISCARD);
+		for (size_t i = 0; i < m_Outputs.size(); ++i)
+		{
+			// the instances are captured one after the other: character c starts at vertex c * vertexCount
+			glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_Outputs[i].buffer);
+			glBeginTransformFeedback(GL_POINTS);
+			glBindVertexArray(m_Model->meshes[i].VAO);
+			glDrawArraysInstanced(GL_POINTS, 0, m_Outputs[i].vertexCount, m_CharacterCount);
+			glEndTransformFeedback();
+		}
+		glBindVertexArray(0);
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+		glDisable(GL_RASTERIZER_DISCARD);
+	}
+
+	// CPU fallback: poses[i] holds the boneCount bone matrices of character i
+	void SkinOnCPU(const glm::mat4* modelMatrices, const glm::mat4* const* poses, int count, int boneCount)
+	{
+		m_CharacterCount = std::min(count, m_MaxCharacters);
+		if (m_CharacterCount <= 0)
+			return;
+
+		for (size_t i = 0; i < m_Outputs.size(); ++i)
+		{
+			MeshOutput& output = m_Outputs[i];
+			const Mesh& mesh = m_Model->meshes[i];
+			m_Vertices.resize((size_t)m_CharacterCount * output.vertexCount);
+			for (int character = 0; character < m_CharacterCount; ++character)
+				SkinVertices(mesh.vertices.data(), output.vertexCount, poses[character], boneCount, modelMatrices[character], &m_Vertices[(size_t)character * output.vertexCount]);
+
+			glBindBuffer(GL_ARRAY_BUFFER, output.buffer);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, m_Vertices.size() * sizeof(PreSkinnedVertex), m_Vertices.data());
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// draws the characters of the last Skin or SkinOnCPU, as many times per frame as there are passes
+	void Draw(Shader& shader)
+	{
+		if (m_CharacterCount <= 0)
+			return;
+		for (size_t i = 0; i < m_Outputs.size(); ++i)
+		{
+			MeshOutput& output = m_Outputs[i];
+			m_Model->meshes[i].bindTextures(shader);
+			glBindVertexArray(output.vertexArray);
+			glMultiDrawElementsBaseVertex(GL_TRIANGLES, output.counts.data(), GL_UNSIGNED_INT, output.indices.data(), m_CharacterCount, output.baseVertices.data());
+		}
+		glBindVertexArray(0);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	int GetMaxCharacters() const { return m_MaxCharacters; }
+	int GetCharacterCount() const { return m_CharacterCount; }
+
+	// size of the skinned vertices of one character
+	static size_t GetCharacterSize(const Model& model)
+	{
+		size_t size = 0;
+		for (const Mesh& mesh : model.meshes)
+			size += mesh.vertices.size() * sizeof(PreSkinnedVertex);
+		return size;
+	}
+
+private:
+	struct MeshOutput
+	{
+		unsigned int buffer = 0;
+		unsigned int vertexArray = 0;
+		int vertexCount = 0;
+		// arguments of the multi draw, one entry per character
+		std::vector<GLsizei> counts;
+		std::vector<const void*> indices;
+		std::vector<GLint> baseVertices;
+	};
+
+	// vertex shader only, its outputs captured interleaved in the order of PreSkinnedVertex
+	static unsigned int CreateSkinningProgram(const char* path)
+	{
+		std::string code;
+		std::ifstream file(path);
+		if (file)
+		{
+			std::stringstream stream;
+			stream << file.rdbuf();
+			code = stream.str();
+		}
+		else
+		{
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+		}
+
+		const char* source = code.c_str();
+		const unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(vertex, 1, &source, NULL);
+		glCompileShader(vertex);
+		int success;
+		char infoLog[1024];
+		glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(vertex, 1024, NULL, infoLog);
+			std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: VERTEX\n" << infoLog << std::endl;
+		}
+
+		const unsigned int program = glCreateProgram();
+		glAttachShader(program, vertex);
+		const char* varyings[] = { "outPosition", "outNormal", "outTexCoords", "outTangent" };
+		glTransformFeedbackVaryings(program, 4, varyings, GL_INTERLEAVED_ATTRIBS);
+		glLinkProgram(program);
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			glGetProgramInfoLog(program, 1024, NULL, infoLog);
+			std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: PROGRAM\n" << infoLog << std::endl;
+		}
+		glDeleteShader(vertex);
+		return program;
+	}
+
+	Model* m_Model;
+	int m_MaxCharacters;
+	int m_CharacterCount = 0;
+	unsigned int m_ModelTextureUnit;
+	unsigned int m_Program = 0;
+	unsigned int m_ModelBuffer = 0;
+	unsigned int m_ModelTexture = 0;
+	std::vector<MeshOutput> m_Outputs;
+	std::vector<PreSkinnedVertex> m_Vertices; // CPU skinning of one mesh for all the characters
+};
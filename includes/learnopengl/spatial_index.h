@@ -0,0 +1,335 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include <glm/glm.hpp> //glm::vec3
+#include <array> //std::array
+#include <vector> //std::vector
+#include <algorithm> //std::sort, std::max, std::min
+#include <limits> //std::numeric_limits
+#include <cmath> //std::abs, std::isinf
+
+//Frustum given by 6 planes: xyz is the normal pointing inside, w the distance, a point p is inside a plane if dot(xyz, p) + w >= 0
+using FrustumPlanes = std::array<glm::vec4, 6>;
+
+//Extract the planes of the frustum from a view projection matrix (Gribb/Hartmann)
+inline FrustumPlanes extractFrustumPlanes(const glm::mat4& viewProjection)
+{
+	const glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+	const glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+	const glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+	const glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+	FrustumPlanes planes = { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row3 + row2, row3 - row2 };
+	for (glm::vec4& plane : planes)
+		plane /= glm::length(glm::vec3(plane));
+	return planes;
+}
+
+//Distance between a point and a box (0 inside)
+inline float distancePointAABB(const glm::vec3& point, const glm::vec3& center, const glm::vec3& extents)
+{
+	return glm::length(glm::max(glm::abs(point - center) - extents, glm::vec3(0.f)));
+}
+
+inline bool intersectAABBAABB(const glm::vec3& centerA, const glm::vec3& extentsA, const glm::vec3& centerB, const glm::vec3& extentsB)
+{
+	const glm::vec3 distance = glm::abs(centerA - centerB);
+	const glm::vec3 extents = extentsA + extentsB;
+	return distance.x <= extents.x && distance.y <= extents.y && distance.z <= extents.z;
+}
+
+inline bool intersectFrustumAABB(const FrustumPlanes& planes, const glm::vec3& center, const glm::vec3& extents)
+{
+	for (const glm::vec4& plane : planes)
+	{
+		//Projection interval radius of the box on the normal of the plane
+		const float r = extents.x * std::abs(plane.x) + extents.y * std::abs(plane.y) + extents.z * std::abs(plane.z);
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -r)
+			return false;
+	}
+	return true;
+}
+
+//Slab test. invDirection is 1 / direction (infinite components are fine). On hit, distance is where the ray enters the box (0 if it starts inside).
+inline bool intersectRayAABB(const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, const glm::vec3& center, const glm::vec3& extents, float& distance)
+{
+	float tEnter = 0.f;
+	float tExit = maxDistance;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const float slabMin = center[axis] - extents[axis];
+		const float slabMax = center[axis] + extents[axis];
+		//Parallel to the slab: inside it or a miss. Multiplying by the infinite inverse would give NaN on its planes
+		if (std::isinf(invDirection[axis]))
+		{
+			if (origin[axis] < slabMin || origin[axis] > slabMax)
+				return false;
+			continue;
+		}
+		const float t0 = (slabMin - origin[axis]) * invDirection[axis];
+		const float t1 = (slabMax - origin[axis]) * invDirection[axis];
+		tEnter = std::max(tEnter, std::min(t0, t1));
+		tExit = std::min(tExit, std::max(t0, t1));
+	}
+	if (tEnter > tExit)
+		return false;
+
+	distance = tEnter;
+	return true;
+}
+
+template<typename T>
+struct SpatialQueryResult
+{
+	T* object;
+	float distance; //From the origin of the query to the box of the object (0 inside), along the ray for ray queries
+};
+
+//Loose octree of axis aligned boxes.
+//The bounds of a node are twice the size of its cell, so an object is stored in exactly one node: the deepest one whose cell
+//size is larger than the object and whose cell contains its center. Moving an object only touches the node lists when it
+//changes of cell, and queries never see an object twice.
+//Objects are identified by the handle returned by insert, which stays valid until remove.
+template<typename T>
+class LooseOctree
+{
+public:
+	static constexpr unsigned int INVALID_INDEX = std::numeric_limits<unsigned int>::max();
+
+	//The cells cover the cube center +/- halfSize. Objects whose center is outside stay in the root node and are tested one by one.
+	LooseOctree(const glm::vec3& center, float halfSize, unsigned int maxDepth = 8)
+		: m_maxDepth{ maxDepth }
+	{
+		m_nodes.emplace_back(center, halfSize, INVALID_INDEX);
+	}
+
+	unsigned int insert(T* object, const glm::vec3& center, const glm::vec3& extents)
+	{
+		unsigned int handle;
+		if (m_freeHandles.empty())
+		{
+			handle = static_cast<unsigned int>(m_records.size());
+			m_records.emplace_back();
+		}
+		else
+		{
+			handle = m_freeHandles.back();
+			m_freeHandles.pop_back();
+		}
+
+		Record& record = m_records[handle];
+		record.object = object;
+		record.center = center;
+		record.extents = extents;
+		attach(handle, findNode(center, extents));
+		++m_size;
+		return handle;
+	}
+
+	//Cheap when the object stays in the same cell: only its box is updated
+	void update(unsigned int handle, const glm::vec3& center, const glm::vec3& extents)
+	{
+		const unsigned int node = findNode(center, extents);
+		Record& record = m_records[handle];
+		record.center = center;
+		record.extents = extents;
+		if (node != record.node)
+		{
+			detach(handle);
+			attach(handle, node);
+		}
+	}
+
+	void remove(unsigned int handle)
+	{
+		detach(handle);
+		m_records[handle].object = nullptr;
+		m_freeHandles.push_back(handle);
+		--m_size;
+	}
+
+	size_t size() const
+	{
+		return m_size;
+	}
+
+	//The results are sorted by distance from center
+	void querySphere(const glm::vec3& center, float radius, std::vector<SpatialQueryResult<T>>& results) const
+	{
+		query(results,
+			[&](const glm::vec3& nodeCenter, const glm::vec3& nodeExtents) { return distancePointAABB(center, nodeCenter, nodeExtents) <= radius; },
+			[&](const Record& record, float& distance)
+			{
+				distance = distancePointAABB(center, record.center, record.extents);
+				return distance <= radius;
+			});
+	}
+
+	//The results are sorted by distance from the center of the query box
+	void queryAABB(const glm::vec3& center, const glm::vec3& extents, std::vector<SpatialQueryResult<T>>& results) const
+	{
+		query(results,
+			[&](const glm::vec3& nodeCenter, const glm::vec3& nodeExtents) { return intersectAABBAABB(center, extents, nodeCenter, nodeExtents); },
+			[&](const Record& record, float& distance)
+			{
+				if (!intersectAABBAABB(center, extents, record.center, record.extents))
+					return false;
+				distance = distancePointAABB(center, record.center, record.extents);
+				return true;
+			});
+	}
+
+	//The results are sorted by distance from viewPoint, usually the position of the camera
+	void queryFrustum(const FrustumPlanes& planes, const glm::vec3& viewPoint, std::vector<SpatialQueryResult<T>>& results) const
+	{
+		query(results,
+			[&](const glm::vec3& nodeCenter, const glm::vec3& nodeExtents) { return intersectFrustumAABB(planes, nodeCenter, nodeExtents); },
+			[&](const Record& record, float& distance)
+			{
+				if (!intersectFrustumAABB(planes, record.center, record.extents))
+					return false;
+				distance = distancePointAABB(viewPoint, record.center, record.extents);
+				return true;
+			});
+	}
+
+	//The results are sorted by distance along the ray, the first one is the picked object
+	void queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<SpatialQueryResult<T>>& results) const
+	{
+		const glm::vec3 invDirection = 1.f / direction;
+		query(results,
+			[&](const glm::vec3& nodeCenter, const glm::vec3& nodeExtents)
+			{
+				float distance;
+				return intersectRayAABB(origin, invDirection, maxDistance, nodeCenter, nodeExtents, distance);
+			},
+			[&](const Record& record, float& distance) { return intersectRayAABB(origin, invDirection, maxDistance, record.center, record.extents, distance); });
+	}
+
+protected:
+	struct Node
+	{
+		glm::vec3 center; //Of the cell, the loose bounds have the same center
+		float halfSize;   //Of the cell, the loose bounds are twice larger
+		unsigned int parent;
+		std::array<unsigned int, 8> children{ { INVALID_INDEX, INVALID_INDEX, INVALID_INDEX, INVALID_INDEX, INVALID_INDEX, INVALID_INDEX, INVALID_INDEX, INVALID_INDEX } };
+		std::vector<unsigned int> objects; //Handles
+		unsigned int subtreeCount = 0;     //Objects in this node and its descendants, to skip empty branches
+
+		Node(const glm::vec3& inCenter, float inHalfSize, unsigned int inParent)
+			: center{ inCenter }, halfSize{ inHalfSize }, parent{ inParent }
+		{}
+	};
+
+	struct Record
+	{
+		T* object = nullptr;
+		glm::vec3 center{ 0.f };
+		glm::vec3 extents{ 0.f };
+		unsigned int node = INVALID_INDEX;
+		unsigned int slot = 0; //Position in the object list of the node
+	};
+
+	//Deepest node whose cell contains the center and is at least as large as the object, created on demand
+	unsigned int findNode(const glm::vec3& center, const glm::vec3& extents)
+	{
+		const glm::vec3 rootDistance = glm::abs(center - m_nodes[0].center);
+		if (std::max(std::max(rootDistance.x, rootDistance.y), rootDistance.z) > m_nodes[0].halfSize)
+			return 0;
+
+		const float objectSize = std::max(std::max(extents.x, extents.y), extents.z);
+		unsigned int nodeIndex = 0;
+		for (unsigned int depth = 0; depth < m_maxDepth; ++depth)
+		{
+			const float childHalfSize = m_nodes[nodeIndex].halfSize * 0.5f;
+			if (objectSize > childHalfSize)
+				break;
+
+			const glm::vec3 nodeCenter = m_nodes[nodeIndex].center;
+			const unsigned int octant = (center.x >= nodeCenter.x ? 1 : 0) | (center.y >= nodeCenter.y ? 2 : 0) | (center.z >= nodeCenter.z ? 4 : 0);
+			unsigned int childIndex = m_nodes[nodeIndex].children[octant];
+			if (childIndex == INVALID_INDEX)
+			{
+				const glm::vec3 childCenter = nodeCenter + glm::vec3(octant & 1 ? childHalfSize : -childHalfSize,
+					octant & 2 ? childHalfSize : -childHalfSize,
+					octant & 4 ? childHalfSize : -childHalfSize);
+				childIndex = static_cast<unsigned int>(m_nodes.size());
+				m_nodes.emplace_back(childCenter, childHalfSize, nodeIndex);
+				m_nodes[nodeIndex].children[octant] = childIndex;
+			}
+			nodeIndex = childIndex;
+		}
+		return nodeIndex;
+	}
+
+	void attach(unsigned int handle, unsigned int nodeIndex)
+	{
+		Record& record = m_records[handle];
+		std::vector<unsigned int>& objects = m_nodes[nodeIndex].objects;
+		record.node = nodeIndex;
+		record.slot = static_cast<unsigned int>(objects.size());
+		objects.push_back(handle);
+
+		for (unsigned int i = nodeIndex; i != INVALID_INDEX; i = m_nodes[i].parent)
+			++m_nodes[i].subtreeCount;
+	}
+
+	//Swap remove from the list of the node
+	void detach(unsigned int handle)
+	{
+		Record& record = m_records[handle];
+		std::vector<unsigned int>& objects = m_nodes[record.node].objects;
+		const unsigned int last = objects.back();
+		objects[record.slot] = last;
+		m_records[last].slot = record.slot;
+		objects.pop_back();
+
+		for (unsigned int i = record.node; i != INVALID_INDEX; i = m_nodes[i].parent)
+			--m_nodes[i].subtreeCount;
+		record.node = INVALID_INDEX;
+	}
+
+	template<typename TNodeTest, typename TObjectTest>
+	void query(std::vector<SpatialQueryResult<T>>& results, TNodeTest nodeTest, TObjectTest objectTest) const
+	{
+		results.clear();
+		m_stack.clear();
+		m_stack.push_back(0);
+		while (!m_stack.empty())
+		{
+			const Node& node = m_nodes[m_stack.back()];
+			m_stack.pop_back();
+
+			//The root holds the objects outside of the cells, its objects are always tested
+			if (node.subtreeCount == 0 || (node.parent != INVALID_INDEX && !nodeTest(node.center, glm::vec3(node.halfSize * 2.f))))
+				continue;
+
+			for (unsigned int handle : node.objects)
+			{
+				const Record& record = m_records[handle];
+				float distance;
+				if (objectTest(record, distance))
+					results.push_back({ record.object, distance });
+			}
+
+			for (unsigned int child : node.children)
+			{
+				if (child != INVALID_INDEX)
+					m_stack.push_back(child);
+			}
+		}
+
+		std::sort(results.begin(), results.end(), [](const SpatialQueryResult<T>& lhs, const SpatialQueryResult<T>& rhs) { return lhs.distance < rhs.distance; });
+	}
+
+	std::vector<Node> m_nodes;
+	std::vector<Record> m_records;
+	std::vector<unsigned int> m_freeHandles;
+	mutable std::vector<unsigned int> m_stack; //Traversal stack kept between queries to avoid allocations
+	unsigned int m_maxDepth;
+	size_t m_size = 0;
+};
+
+template<typename T>
+constexpr unsigned int LooseOctree<T>::INVALID_INDEX;
+#endif
@@ -9,8 +9,10 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/hiz_culling.h>
 
 #include <iostream>
+#include <limits>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -34,6 +36,10 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// occlusion culling
+bool hiZCulling = true;
+bool hiZCullingKeyPressed = false;
+
 int main()
 {
     // glfw: initialize and configure
@@ -130,17 +136,38 @@ int main()
     // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering 
     unsigned int attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
     glDrawBuffers(3, attachments);
-    // create and attach depth buffer (renderbuffer)
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+    // create and attach depth buffer (texture, so the Hi-Z pyramid can be built from it)
+    unsigned int gDepth;
+    glGenTextures(1, &gDepth);
+    glBindTexture(GL_TEXTURE_2D, gDepth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gDepth, 0);
     // finally check if framebuffer is complete
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "Framebuffer not complete!" << std::endl;
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+    // Hi-Z occlusion culling of the geometry pass
+    // -------------------------------------------
+    HiZPyramid hiZ(SCR_WIDTH, SCR_HEIGHT, true);
+    std::vector<unsigned int> hiZOccluded;
+    float hiZStatsTimer = 0.0f;
+    // local space bounding box of the backpack
+    glm::vec3 backpackMin(std::numeric_limits<float>::max());
+    glm::vec3 backpackMax(std::numeric_limits<float>::lowest());
+    for (const Mesh& mesh : backpack.meshes)
+    {
+        for (const Vertex& vertex : mesh.vertices)
+        {
+            backpackMin = glm::min(backpackMin, vertex.Position);
+            backpackMax = glm::max(backpackMax, vertex.Position);
+        }
+    }
+    const glm::vec3 backpackCenter = (backpackMin + backpackMax) * 0.5f;
+    const glm::vec3 backpackExtents = (backpackMax - backpackMin) * 0.5f;
+
     // lighting info
     // -------------
     const unsigned int NR_LIGHTS = 32;
@@ -197,13 +224,49 @@ int main()
             shaderGeometryPass.use();
             shaderGeometryPass.setMat4("projection", projection);
             shaderGeometryPass.setMat4("view", view);
+            // phase 1: draw the objects visible in the Hi-Z pyramid of the previous frame
+            HiZStats hiZStats;
+            hiZOccluded.clear();
             for (unsigned int i = 0; i < objectPositions.size(); i++)
             {
                 model = glm::mat4(1.0f);
                 model = glm::translate(model, objectPositions[i]);
                 model = glm::scale(model, glm::vec3(0.5f));
+                if (hiZCulling && !hiZ.isVisible(backpackCenter, backpackExtents, model))
+                {
+                    hiZOccluded.push_back(i);
+                    continue;
+                }
                 shaderGeometryPass.setMat4("model", model);
                 backpack.Draw(shaderGeometryPass);
+                hiZStats.firstPhaseDrawn++;
+            }
+            // phase 2: build the pyramid from the depth of phase 1 and draw the objects that became visible since the previous frame
+            if (hiZCulling)
+            {
+                hiZ.build(gDepth, projection * view);
+                shaderGeometryPass.use();
+                for (unsigned int i : hiZOccluded)
+                {
+                    model = glm::mat4(1.0f);
+                    model = glm::translate(model, objectPositions[i]);
+                    model = glm::scale(model, glm::vec3(0.5f));
+                    if (!hiZ.isVisible(backpackCenter, backpackExtents, model))
+                    {
+                        hiZStats.culled++;
+                        continue;
+                    }
+                    shaderGeometryPass.setMat4("model", model);
+                    backpack.Draw(shaderGeometryPass);
+                    hiZStats.secondPhaseDrawn++;
+                }
+            }
+            hiZStatsTimer += deltaTime;
+            if (hiZStatsTimer >= 1.0f)
+            {
+                std::cout << "Hi-Z culling : " << (hiZCulling ? "on" : "off") << " / drawn : " << hiZStats.firstPhaseDrawn << " + " << hiZStats.secondPhaseDrawn
+                    << " disoccluded / culled : " << hiZStats.culled << std::endl;
+                hiZStatsTimer = 0.0f;
             }
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
@@ -390,6 +453,16 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS && !hiZCullingKeyPressed)
+    {
+        hiZCulling = !hiZCulling;
+        hiZCullingKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_RELEASE)
+    {
+        hiZCullingKeyPressed = false;
+    }
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -7,6 +7,7 @@
 ** option) any later version.
 ******************************************************************/
 #include <algorithm>
+#include <cmath>
 #include <sstream>
 #include <iostream>
 
@@ -21,8 +22,10 @@ using namespace irrklang;
 #include "game_object.h"
 #include "ball_object.h"
 #include "particle_generator.h"
+#include "gpu_particle_system.h"
 #include "post_processor.h"
 #include "text_renderer.h"
+#include "random_generator.h"
 
 
 // Game-related State data
@@ -30,11 +33,25 @@ SpriteRenderer    *Renderer;
 GameObject        *Player;
 BallObject        *Ball;
 ParticleGenerator *Particles;
+GPUParticleSystem *GPUParticles;
 PostProcessor     *Effects;
 ISoundEngine      *SoundEngine = createIrrKlangDevice();
 TextRenderer      *Text;
+RandomGenerator   Random;
 
 float ShakeTime = 0.0f;
+// positions of the ball and the player at the start of the last step, the render interpolates from them
+glm::vec2 LastBallPosition, LastPlayerPosition;
+// particle stress test timings, accumulated over a second
+float  ParticleReportTime = 0.0f;
+double ParticleUpdateTime = 0.0, ParticleDrawTime = 0.0;
+unsigned int ParticleFrames = 0;
+// collision benchmark timings, accumulated over a second
+float  CollisionReportTime = 0.0f;
+double CollisionTime = 0.0;
+unsigned int CollisionFrames = 0;
+// bricks the ball may touch this frame
+std::vector<GameObject*> CollisionCandidates;
 
 
 Game::Game(unsigned int width, unsigned int height) 
@@ -49,6 +66,7 @@ Game::~Game()
     delete Player;
     delete Ball;
     delete Particles;
+    delete GPUParticles;
     delete Effects;
     delete Text;
     SoundEngine->drop();
@@ -60,28 +78,45 @@ void Game::Init()
     ResourceManager::LoadShader("sprite.vs", "sprite.fs", nullptr, "sprite");
     ResourceManager::LoadShader("particle.vs", "particle.fs", nullptr, "particle");
     ResourceManager::LoadShader("post_processing.vs", "post_processing.fs", nullptr, "postprocessing");
+    if (GPU_PARTICLES)
+    {
+        ResourceManager::LoadShader("particle_gpu.vs", "particle.fs", nullptr, "particle_gpu");
+        ResourceManager::LoadComputeShader("particle_prepare.cs", "particle_prepare");
+        ResourceManager::LoadComputeShader("particle_simulate.cs", "particle_simulate");
+    }
     // configure shaders
     glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(this->Width), static_cast<float>(this->Height), 0.0f, -1.0f, 1.0f);
     ResourceManager::GetShader("sprite").Use().SetInteger("sprite", 0);
     ResourceManager::GetShader("sprite").SetMatrix4("projection", projection);
     ResourceManager::GetShader("particle").Use().SetInteger("sprite", 0);
     ResourceManager::GetShader("particle").SetMatrix4("projection", projection);
+    if (GPU_PARTICLES)
+    {
+        ResourceManager::GetShader("particle_gpu").Use().SetInteger("sprite", 0);
+        ResourceManager::GetShader("particle_gpu").SetMatrix4("projection", projection);
+    }
     // load textures
     ResourceManager::LoadTexture(FileSystem::getPath("resources/textures/background.jpg").c_str(), false, "background");
-    ResourceManager::LoadTexture(FileSystem::getPath("resources/textures/awesomeface.png").c_str(), true, "face");
-    ResourceManager::LoadTexture(FileSystem::getPath("resources/textures/block.png").c_str(), false, "block");
-    ResourceManager::LoadTexture(FileSystem::getPath("resources/textures/block_solid.png").c_str(), false, "block_solid");
-    ResourceManager::LoadTexture(FileSystem::getPath("resources/textures/paddle.png").c_str(), true, "paddle");
-    ResourceManager::LoadTexture(FileSystem::getPath("resources/textures/particle.png").c_str(), true, "particle");
-    ResourceManager::LoadTexture(FileSystem::getPath("resources/textures/powerup_speed.png").c_str(), true, "powerup_speed");
-    ResourceManager::LoadTexture(FileSystem::getPath("resources/textures/powerup_sticky.png").c_str(), true, "powerup_sticky");
-    ResourceManager::LoadTexture(FileSystem::getPath("resources/textures/powerup_increase.png").c_str(), true, "powerup_increase");
-    ResourceManager::LoadTexture(FileSystem::getPath("resources/textures/powerup_confuse.png").c_str(), true, "powerup_confuse");
-    ResourceManager::LoadTexture(FileSystem::getPath("resources/textures/powerup_chaos.png").c_str(), true, "powerup_chaos");
-    ResourceManager::LoadTexture(FileSystem::getPath("resources/textures/powerup_passthrough.png").c_str(), true, "powerup_passthrough");
+    // the sprites are packed in an atlas so that they share one texture (the background is too large)
+    ResourceManager::QueueAtlasTexture(FileSystem::getPath("resources/textures/awesomeface.png").c_str(), true, "face");
+    ResourceManager::QueueAtlasTexture(FileSystem::getPath("resources/textures/block.png").c_str(), false, "block");
+    ResourceManager::QueueAtlasTexture(FileSystem::getPath("resources/textures/block_solid.png").c_str(), false, "block_solid");
+    ResourceManager::QueueAtlasTexture(FileSystem::getPath("resources/textures/paddle.png").c_str(), true, "paddle");
+    ResourceManager::QueueAtlasTexture(FileSystem::getPath("resources/textures/particle.png").c_str(), true, "particle");
+    ResourceManager::QueueAtlasTexture(FileSystem::getPath("resources/textures/powerup_speed.png").c_str(), true, "powerup_speed");
+    ResourceManager::QueueAtlasTexture(FileSystem::getPath("resources/textures/powerup_sticky.png").c_str(), true, "powerup_sticky");
+    ResourceManager::QueueAtlasTexture(FileSystem::getPath("resources/textures/powerup_increase.png").c_str(), true, "powerup_increase");
+    ResourceManager::QueueAtlasTexture(FileSystem::getPath("resources/textures/powerup_confuse.png").c_str(), true, "powerup_confuse");
+    ResourceManager::QueueAtlasTexture(FileSystem::getPath("resources/textures/powerup_chaos.png").c_str(), true, "powerup_chaos");
+    ResourceManager::QueueAtlasTexture(FileSystem::getPath("resources/textures/powerup_passthrough.png").c_str(), true, "powerup_passthrough");
+    // the atlas cache is machine specific: it goes in the working directory, next to the shaders
+    ResourceManager::LoadAtlas(2048, 2, "breakout.atlascache");
     // set render-specific controls
     Renderer = new SpriteRenderer(ResourceManager::GetShader("sprite"));
-    Particles = new ParticleGenerator(ResourceManager::GetShader("particle"), ResourceManager::GetTexture("particle"), 500);
+    if (GPU_PARTICLES)
+        GPUParticles = new GPUParticleSystem(ResourceManager::GetShader("particle_prepare"), ResourceManager::GetShader("particle_simulate"), ResourceManager::GetShader("particle_gpu"), ResourceManager::GetTexture("particle"), PARTICLE_STRESS_TEST ? GPU_PARTICLE_STRESS_AMOUNT : PARTICLE_AMOUNT);
+    else
+        Particles = new ParticleGenerator(ResourceManager::GetShader("particle"), ResourceManager::GetTexture("particle"), PARTICLE_AMOUNT, PARTICLE_STRESS_TEST ? PARTICLE_STRESS_AMOUNT : PARTICLE_AMOUNT);
     Effects = new PostProcessor(ResourceManager::GetShader("postprocessing"), this->Width, this->Height);
     Text = new TextRenderer(this->Width, this->Height);
     Text->Load(FileSystem::getPath("resources/fonts/OCRAEXT.TTF").c_str(), 24);
@@ -90,6 +125,8 @@ void Game::Init()
     GameLevel two; two.Load(FileSystem::getPath("resources/levels/two.lvl").c_str(), this->Width, this->Height /2 );
     GameLevel three; three.Load(FileSystem::getPath("resources/levels/three.lvl").c_str(), this->Width, this->Height / 2);
     GameLevel four; four.Load(FileSystem::getPath("resources/levels/four.lvl").c_str(), this->Width, this->Height / 2);
+    if (COLLISION_BENCHMARK)
+        one.Generate(200, 100, this->Width, this->Height / 2);
     this->Levels.push_back(one);
     this->Levels.push_back(two);
     this->Levels.push_back(three);
@@ -100,18 +137,71 @@ void Game::Init()
     Player = new GameObject(playerPos, PLAYER_SIZE, ResourceManager::GetTexture("paddle"));
     glm::vec2 ballPos = playerPos + glm::vec2(PLAYER_SIZE.x / 2.0f - BALL_RADIUS, -BALL_RADIUS * 2.0f);
     Ball = new BallObject(ballPos, BALL_RADIUS, INITIAL_BALL_VELOCITY, ResourceManager::GetTexture("face"));
+    LastBallPosition = Ball->Position;
+    LastPlayerPosition = Player->Position;
+    // random choices
+    Random.Seed(SIMULATION_SEED);
+    if (!GPU_PARTICLES)
+        Particles->Seed(SIMULATION_SEED);
     // audio
     SoundEngine->play2D(FileSystem::getPath("resources/audio/breakout.mp3").c_str(), true);
 }
 
+void Game::Step(float dt)
+{
+    LastBallPosition = Ball->Position;
+    LastPlayerPosition = Player->Position;
+    this->ProcessInput(dt);
+    this->Update(dt);
+}
+
 void Game::Update(float dt)
 {
     // update objects
+    glm::vec2 previousBallPosition = Ball->Position;
     Ball->Move(dt, this->Width);
     // check for collisions
-    this->DoCollisions();
-    // update particles
-    Particles->Update(dt, *Ball, 2, glm::vec2(Ball->Radius / 2.0f));
+    double collisionStart = glfwGetTime();
+    this->DoCollisions(previousBallPosition);
+    if (COLLISION_BENCHMARK)
+    {
+        CollisionTime += glfwGetTime() - collisionStart;
+        ++CollisionFrames;
+        CollisionReportTime += dt;
+        if (CollisionReportTime >= 1.0f)
+        {
+            std::cout << "collisions: " << this->Levels[this->Level].Bricks.size() << " bricks, " << 1000.0 * CollisionTime / CollisionFrames << " ms" << std::endl;
+            CollisionReportTime = 0.0f;
+            CollisionTime = 0.0;
+            CollisionFrames = 0;
+        }
+    }
+    // update particles, particles live for a second: in the stress test spawning the pool size per second keeps it full
+    unsigned int stressAmount = GPU_PARTICLES ? GPU_PARTICLE_STRESS_AMOUNT : PARTICLE_STRESS_AMOUNT;
+    unsigned int newParticles = PARTICLE_STRESS_TEST ? (unsigned int)(stressAmount * dt) + 1 : 2;
+    double particleStart = glfwGetTime();
+    if (GPU_PARTICLES)
+        GPUParticles->Update(dt, *Ball, newParticles, glm::vec2(Ball->Radius / 2.0f));
+    else
+        Particles->Update(dt, *Ball, newParticles, glm::vec2(Ball->Radius / 2.0f));
+    if (PARTICLE_STRESS_TEST)
+    {
+        ParticleUpdateTime += glfwGetTime() - particleStart;
+        ++ParticleFrames;
+        ParticleReportTime += dt;
+        if (ParticleReportTime >= 1.0f)
+        {
+            // the GPU simulation only costs the CPU the submission of its commands
+            std::cout << "particles: " << (GPU_PARTICLES ? GPUParticles->GetLiveCount() : Particles->GetLiveCount()) << " live, frame " << 1000.0f * ParticleReportTime / ParticleFrames << " ms, update "
+                      << 1000.0 * ParticleUpdateTime / ParticleFrames << " ms, draw (CPU) " << 1000.0 * ParticleDrawTime / ParticleFrames << " ms";
+            if (!GPU_PARTICLES)
+                std::cout << ", pool " << Particles->GetAmount() << " (" << Particles->GetStats().Grows << " grows, " << Particles->GetStats().Dropped << " dropped)";
+            std::cout << std::endl;
+            ParticleReportTime = 0.0f;
+            ParticleUpdateTime = ParticleDrawTime = 0.0;
+            ParticleFrames = 0;
+        }
+    }
     // update PowerUps
     this->UpdatePowerUps(dt);
     // reduce shake time
@@ -204,10 +294,14 @@ void Game::ProcessInput(float dt)
     }
 }
 
-void Game::Render()
+void Game::Render(float alpha)
 {
     if (this->State == GAME_ACTIVE || this->State == GAME_MENU || this->State == GAME_WIN)
     {
+        // draw the ball and the player where they are at alpha between the last two steps
+        glm::vec2 ballPosition = Ball->Position, playerPosition = Player->Position;
+        Ball->Position = glm::mix(LastBallPosition, ballPosition, alpha);
+        Player->Position = glm::mix(LastPlayerPosition, playerPosition, alpha);
         // begin rendering to postprocessing framebuffer
         Effects->BeginRender();
             // draw background
@@ -220,10 +314,20 @@ void Game::Render()
             for (PowerUp &powerUp : this->PowerUps)
                 if (!powerUp.Destroyed)
                     powerUp.Draw(*Renderer);
+            // particles use their own shader: draw the sprites batched so far first
+            Renderer->Flush();
             // draw particles	
-            Particles->Draw();
+            double particleStart = glfwGetTime();
+            if (GPU_PARTICLES)
+                GPUParticles->Draw();
+            else
+                Particles->Draw();
+            ParticleDrawTime += glfwGetTime() - particleStart;
             // draw ball
             Ball->Draw(*Renderer);            
+            Renderer->Flush();
+            Ball->Position = ballPosition;
+            Player->Position = playerPosition;
         // end rendering to postprocessing framebuffer
         Effects->EndRender();
         // render postprocessing quad
@@ -247,7 +351,9 @@ void Game::Render()
 
 void Game::ResetLevel()
 {
-    if (this->Level == 0)
+    if (this->Level == 0 && COLLISION_BENCHMARK)
+        this->Levels[0].Generate(200, 100, this->Width, this->Height / 2);
+    else if (this->Level == 0)
         this->Levels[0].Load("levels/one.lvl", this->Width, this->Height / 2);
     else if (this->Level == 1)
         this->Levels[1].Load("levels/two.lvl", this->Width, this->Height / 2);
@@ -270,6 +376,9 @@ void Game::ResetPlayer()
     Ball->PassThrough = Ball->Sticky = false;
     Player->Color = glm::vec3(1.0f);
     Ball->Color = glm::vec3(1.0f);
+    // no interpolation from the positions before the reset
+    LastBallPosition = Ball->Position;
+    LastPlayerPosition = Player->Position;
 }
 
 
@@ -332,7 +441,7 @@ void Game::UpdatePowerUps(float dt)
 
 bool ShouldSpawn(unsigned int chance)
 {
-    unsigned int random = rand() % chance;
+    unsigned int random = Random.NextInt(chance);
     return random == 0;
 }
 void Game::SpawnPowerUps(GameObject &block)
@@ -400,30 +509,91 @@ bool IsOtherPowerUpActive(std::vector<PowerUp> &powerUps, std::string type)
 // collision detection
 bool CheckCollision(GameObject &one, GameObject &two);
 Collision CheckCollision(BallObject &one, GameObject &two);
+bool SweepCollision(glm::vec2 center, glm::vec2 motion, float radius, GameObject &box, float &time, glm::vec2 &normal);
 Direction VectorDirection(glm::vec2 closest);
 
-void Game::DoCollisions()
+// distance the ball is kept off a brick it bounced on, so that it doesn't touch it after the bounce
+const float COLLISION_SKIN = 0.01f;
+// bounces of the ball on bricks within a step, past that it stops where it is for the step
+const unsigned int MAX_BOUNCES = 4;
+
+void Game::DoCollisions(glm::vec2 previousBallPosition)
 {
-    for (GameObject &box : this->Levels[this->Level].Bricks)
+    GameLevel &level = this->Levels[this->Level];
+    // effects of the ball hitting a brick
+    auto hitBrick = [&](GameObject &box)
+    {
+        // destroy block if not solid
+        if (!box.IsSolid)
+        {
+            level.DestroyBrick(box);
+            this->SpawnPowerUps(box);
+            SoundEngine->play2D(FileSystem::getPath("resources/audio/bleep.mp3").c_str(), false);
+        }
+        else
+        {   // if block is solid, enable shake effect
+            ShakeTime = 0.05f;
+            Effects->Shake = true;
+            SoundEngine->play2D(FileSystem::getPath("resources/audio/bleep.mp3").c_str(), false);
+        }
+    };
+    // the center of the ball moved by motion during this step: it is swept against the bricks so that
+    // a fast ball can't go through a brick between two steps. Bouncing keeps the ball within the
+    // length of motion from where it started, only the bricks on the tiles of that area are tested
+    glm::vec2 center = previousBallPosition + Ball->Radius;
+    glm::vec2 motion = Ball->Position - previousBallPosition;
+    float reach = glm::length(motion) + Ball->Radius;
+    CollisionCandidates.clear();
+    level.QueryBricks(center - reach, center + reach, CollisionCandidates);
+    unsigned int bounces = 0;
+    while (bounces < MAX_BOUNCES)
+    {
+        // first brick on the way
+        GameObject *hit = nullptr;
+        float hitTime = 1.0f;
+        glm::vec2 hitNormal;
+        for (GameObject *brick : CollisionCandidates)
+        {
+            float time;
+            glm::vec2 normal;
+            if (!brick->Destroyed && SweepCollision(center, motion, Ball->Radius, *brick, time, normal) && time <= hitTime)
+            {
+                hit = brick;
+                hitTime = time;
+                hitNormal = normal;
+            }
+        }
+        if (!hit)
+            break;
+        hitBrick(*hit);
+        if (Ball->PassThrough && !hit->IsSolid) // the ball goes on through non-solid bricks if pass-through is activated
+            continue;
+        // collision resolution: move the ball to the brick and bounce off it for the rest of the step
+        center += motion * hitTime + hitNormal * COLLISION_SKIN;
+        motion *= 1.0f - hitTime;
+        if (std::abs(hitNormal.x) > std::abs(hitNormal.y)) // horizontal collision
+        {
+            Ball->Velocity.x = std::copysign(Ball->Velocity.x, hitNormal.x);
+            motion.x = std::copysign(motion.x, hitNormal.x);
+        }
+        else // vertical collision
+        {
+            Ball->Velocity.y = std::copysign(Ball->Velocity.y, hitNormal.y);
+            motion.y = std::copysign(motion.y, hitNormal.y);
+        }
+        ++bounces;
+    }
+    Ball->Position = bounces < MAX_BOUNCES ? center + motion - Ball->Radius : center - Ball->Radius;
+    // the sweep leaves out the bricks the ball overlaps at the start of the step: push it out of them
+    for (GameObject *brick : CollisionCandidates)
     {
+        GameObject &box = *brick;
         if (!box.Destroyed)
         {
             Collision collision = CheckCollision(*Ball, box);
             if (std::get<0>(collision)) // if collision is true
             {
-                // destroy block if not solid
-                if (!box.IsSolid)
-                {
-                    box.Destroyed = true;
-                    this->SpawnPowerUps(box);
-                    SoundEngine->play2D(FileSystem::getPath("resources/audio/bleep.mp3").c_str(), false);
-                }
-                else
-                {   // if block is solid, enable shake effect
-                    ShakeTime = 0.05f;
-                    Effects->Shake = true;
-                    SoundEngine->play2D(FileSystem::getPath("resources/audio/bleep.mp3").c_str(), false);
-                }
+                hitBrick(box);
                 // collision resolution
                 Direction dir = std::get<1>(collision);
                 glm::vec2 diff_vector = std::get<2>(collision);
@@ -530,6 +700,89 @@ Collision CheckCollision(BallObject &one, GameObject &two) // AABB - Circle coll
         return std::make_tuple(false, UP, glm::vec2(0.0f, 0.0f));
 }
 
+// time in [0, 1] at which a point moving by motion from start enters the rectangle [rectMin, rectMax] (slab test)
+bool SweepRectangle(glm::vec2 start, glm::vec2 motion, glm::vec2 rectMin, glm::vec2 rectMax, float &time, glm::vec2 &normal)
+{
+    float enter = 0.0f, exit = 1.0f;
+    int axis = -1;
+    for (int i = 0; i < 2; ++i)
+    {
+        if (motion[i] == 0.0f)
+        {
+            if (start[i] < rectMin[i] || start[i] > rectMax[i])
+                return false;
+            continue;
+        }
+        float t0 = (rectMin[i] - start[i]) / motion[i];
+        float t1 = (rectMax[i] - start[i]) / motion[i];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        if (t0 > enter)
+        {
+            enter = t0;
+            axis = i;
+        }
+        exit = std::min(exit, t1);
+        if (enter > exit)
+            return false;
+    }
+    if (axis < 0) // inside from the start
+        return false;
+    time = enter;
+    normal = glm::vec2(0.0f);
+    normal[axis] = motion[axis] > 0.0f ? -1.0f : 1.0f;
+    return true;
+}
+
+// time in [0, 1] at which a point moving by motion from start enters the circle of the given center and radius
+bool SweepCircle(glm::vec2 start, glm::vec2 motion, glm::vec2 center, float radius, float &time, glm::vec2 &normal)
+{
+    glm::vec2 offset = start - center;
+    float a = glm::dot(motion, motion);
+    float b = glm::dot(offset, motion);
+    float c = glm::dot(offset, offset) - radius * radius;
+    float discriminant = b * b - a * c;
+    if (b >= 0.0f || discriminant < 0.0f) // moving away or passing by
+        return false;
+    float t = (-b - std::sqrt(discriminant)) / a;
+    if (t < 0.0f || t > 1.0f)
+        return false;
+    time = t;
+    normal = (offset + motion * t) / radius;
+    return true;
+}
+
+// Circle - AABB swept collision: the time in [0, 1] at which a circle moving by motion from center first touches
+// the box and the normal of the box there. The centers touching the box make the box grown by the radius with
+// rounded corners: the union of the box grown horizontally, the box grown vertically and the circles around its
+// corners. A circle overlapping the box at the start doesn't collide, it is left to CheckCollision.
+bool SweepCollision(glm::vec2 center, glm::vec2 motion, float radius, GameObject &box, float &time, glm::vec2 &normal)
+{
+    glm::vec2 boxMin = box.Position, boxMax = box.Position + box.Size;
+    glm::vec2 closest = glm::clamp(center, boxMin, boxMax);
+    if (glm::length(closest - center) < radius)
+        return false;
+    // first of the parts entered
+    bool hit = false;
+    float partTime;
+    glm::vec2 partNormal;
+    auto keepFirst = [&](bool partHit)
+    {
+        if (partHit && (!hit || partTime < time))
+        {
+            hit = true;
+            time = partTime;
+            normal = partNormal;
+        }
+    };
+    keepFirst(SweepRectangle(center, motion, boxMin - glm::vec2(radius, 0.0f), boxMax + glm::vec2(radius, 0.0f), partTime, partNormal));
+    keepFirst(SweepRectangle(center, motion, boxMin - glm::vec2(0.0f, radius), boxMax + glm::vec2(0.0f, radius), partTime, partNormal));
+    glm::vec2 corners[] = { boxMin, glm::vec2(boxMax.x, boxMin.y), glm::vec2(boxMin.x, boxMax.y), boxMax };
+    for (glm::vec2 corner : corners)
+        keepFirst(SweepCircle(center, motion, corner, radius, partTime, partNormal));
+    return hit;
+}
+
 // calculates which direction a vector is facing (N,E,S or W)
 Direction VectorDirection(glm::vec2 target)
 {
@@ -42,6 +42,23 @@ const float PLAYER_VELOCITY(500.0f);
 const glm::vec2 INITIAL_BALL_VELOCITY(100.0f, -350.0f);
 // Radius of the ball object
 const float BALL_RADIUS = 12.5f;
+// Number of particles of the ball's trail
+const unsigned int PARTICLE_AMOUNT = 500;
+// Stress test of the particle system: the trail's pool grows to PARTICLE_STRESS_AMOUNT particles kept alive and the particle timings are printed every second
+const bool PARTICLE_STRESS_TEST = false;
+const unsigned int PARTICLE_STRESS_AMOUNT = 100000;
+// Simulates the trail with compute shaders instead of the CPU (requires OpenGL 4.3, not available on macOS)
+const bool GPU_PARTICLES = false;
+const unsigned int GPU_PARTICLE_STRESS_AMOUNT = 1000000;
+// Collision benchmark: the first level is replaced by a generated level of 200x100 tiles and the collision timings are printed every second
+const bool COLLISION_BENCHMARK = false;
+// Duration of a simulation step: the game advances in steps of this length whatever the frame rate,
+// so the same input always gives the same game
+const float SIMULATION_STEP = 1.0f / 120.0f;
+// Longest frame time simulated: after a longer hitch the game slows down instead of running many steps to catch up
+const float MAX_FRAME_TIME = 0.25f;
+// Seed of the random choices of the game (powerups and particles)
+const unsigned int SIMULATION_SEED = 1;
 
 // Game holds all game-related state and functionality.
 // Combines all game-related data into a single class for
@@ -66,8 +83,11 @@ public:
     // game loop
     void ProcessInput(float dt);
     void Update(float dt);
-    void Render();
-    void DoCollisions();
+    // advances the game by one simulation step: input and update
+    void Step(float dt);
+    // alpha interpolates the moving objects between the last two steps (0: previous step, 1: last step)
+    void Render(float alpha = 1.0f);
+    void DoCollisions(glm::vec2 previousBallPosition);
     // reset
     void ResetLevel();
     void ResetPlayer();
@@ -8,6 +8,8 @@
 ******************************************************************/
 #include "game_level.h"
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <sstream>
 
@@ -16,6 +18,8 @@ void GameLevel::Load(const char *file, unsigned int levelWidth, unsigned int lev
 {
     // clear old data
     this->Bricks.clear();
+    this->tiles.clear();
+    this->tilesX = this->tilesY = 0;
     // load from file
     unsigned int tileCode;
     GameLevel level;
@@ -37,10 +41,32 @@ void GameLevel::Load(const char *file, unsigned int levelWidth, unsigned int lev
     }
 }
 
+void GameLevel::Generate(unsigned int tilesX, unsigned int tilesY, unsigned int levelWidth, unsigned int levelHeight, unsigned int seed)
+{
+    this->Bricks.clear();
+    this->tiles.clear();
+    // about one empty tile and one solid brick out of eight, colored bricks elsewhere
+    std::vector<std::vector<unsigned int>> tileData(tilesY, std::vector<unsigned int>(tilesX));
+    unsigned int state = seed;
+    for (std::vector<unsigned int> &row : tileData)
+        for (unsigned int &tile : row)
+        {
+            state = state * 1664525u + 1013904223u;
+            unsigned int value = (state >> 16) % 8;
+            tile = value == 0 ? 0 : value == 1 ? 1 : 2 + value % 4;
+        }
+    if (tilesY > 0 && tilesX > 0)
+        this->init(tileData, levelWidth, levelHeight);
+}
+
 void GameLevel::Draw(SpriteRenderer &renderer)
 {
+    // bricks don't overlap: draw the solid ones first so that each texture is one batch of the renderer
+    for (GameObject &tile : this->Bricks)
+        if (tile.IsSolid && !tile.Destroyed)
+            tile.Draw(renderer);
     for (GameObject &tile : this->Bricks)
-        if (!tile.Destroyed)
+        if (!tile.IsSolid && !tile.Destroyed)
             tile.Draw(renderer);
 }
 
@@ -52,12 +78,47 @@ bool GameLevel::IsCompleted()
     return true;
 }
 
+void GameLevel::QueryBricks(glm::vec2 min, glm::vec2 max, std::vector<GameObject*> &bricks)
+{
+    if (this->tiles.empty() || max.x < 0.0f || max.y < 0.0f)
+        return;
+    // range of tiles covered by the area, clamped to the grid
+    int lastX = (int)this->tilesX - 1, lastY = (int)this->tilesY - 1;
+    int x0 = std::min((int)std::floor(std::max(min.x, 0.0f) / this->unitWidth), lastX + 1);
+    int y0 = std::min((int)std::floor(std::max(min.y, 0.0f) / this->unitHeight), lastY + 1);
+    int x1 = std::min((int)std::floor(max.x / this->unitWidth), lastX);
+    int y1 = std::min((int)std::floor(max.y / this->unitHeight), lastY);
+    for (int y = y0; y <= y1; ++y)
+        for (int x = x0; x <= x1; ++x)
+        {
+            int brick = this->tiles[y * this->tilesX + x];
+            if (brick >= 0 && !this->Bricks[brick].Destroyed)
+                bricks.push_back(&this->Bricks[brick]);
+        }
+}
+
+void GameLevel::DestroyBrick(GameObject &brick)
+{
+    if (brick.Destroyed || brick.IsSolid)
+        return;
+    brick.Destroyed = true;
+    // the tile of a brick follows from its position, bricks never move
+    unsigned int x = (unsigned int)std::lround(brick.Position.x / this->unitWidth);
+    unsigned int y = (unsigned int)std::lround(brick.Position.y / this->unitHeight);
+    this->tiles[y * this->tilesX + x] = -1;
+}
+
 void GameLevel::init(std::vector<std::vector<unsigned int>> tileData, unsigned int levelWidth, unsigned int levelHeight)
 {
     // calculate dimensions
     unsigned int height = tileData.size();
     unsigned int width = tileData[0].size(); // note we can index vector at [0] since this function is only called if height > 0
     float unit_width = levelWidth / static_cast<float>(width), unit_height = levelHeight / height; 
+    this->tilesX = width;
+    this->tilesY = height;
+    this->unitWidth = unit_width;
+    this->unitHeight = unit_height;
+    this->tiles.assign(width * height, -1);
     // initialize level tiles based on tileData		
     for (unsigned int y = 0; y < height; ++y)
     {
@@ -70,6 +131,7 @@ void GameLevel::init(std::vector<std::vector<unsigned int>> tileData, unsigned i
                 glm::vec2 size(unit_width, unit_height);
                 GameObject obj(pos, size, ResourceManager::GetTexture("block_solid"), glm::vec3(0.8f, 0.8f, 0.7f));
                 obj.IsSolid = true;
+                this->tiles[y * width + x] = (int)this->Bricks.size();
                 this->Bricks.push_back(obj);
             }
             else if (tileData[y][x] > 1)	// non-solid; now determine its color based on level data
@@ -86,6 +148,7 @@ void GameLevel::init(std::vector<std::vector<unsigned int>> tileData, unsigned i
 
                 glm::vec2 pos(unit_width * x, unit_height * y);
                 glm::vec2 size(unit_width, unit_height);
+                this->tiles[y * width + x] = (int)this->Bricks.size();
                 this->Bricks.push_back(GameObject(pos, size, ResourceManager::GetTexture("block"), color));
             }
         }
@@ -20,20 +20,33 @@
 
 /// GameLevel holds all Tiles as part of a Breakout level and 
 /// hosts functionality to Load/render levels from the harddisk.
+/// Bricks sit on a regular grid of tiles; the level keeps the index of
+/// the live brick of every tile so that collision detection only looks
+/// at the tiles around the ball instead of at every brick.
 class GameLevel
 {
 public:
     // level state
     std::vector<GameObject> Bricks;
     // constructor
-    GameLevel() { }
+    GameLevel() : tilesX(0), tilesY(0), unitWidth(0.0f), unitHeight(0.0f) { }
     // loads level from file
     void Load(const char *file, unsigned int levelWidth, unsigned int levelHeight);
+    // generates a level of tilesX x tilesY tiles with the same mix of bricks for every seed, for benchmarks
+    void Generate(unsigned int tilesX, unsigned int tilesY, unsigned int levelWidth, unsigned int levelHeight, unsigned int seed = 1);
     // render level
     void Draw(SpriteRenderer &renderer);
     // check if the level is completed (all non-solid tiles are destroyed)
     bool IsCompleted();
+    // appends the live bricks whose tiles overlap the area between min and max, in the order of Bricks
+    void QueryBricks(glm::vec2 min, glm::vec2 max, std::vector<GameObject*> &bricks);
+    // destroys a non-solid brick and removes it from its tile
+    void DestroyBrick(GameObject &brick);
 private:
+    // tile grid: index in Bricks of the live brick of each tile (row by row), -1 if there is none
+    std::vector<int> tiles;
+    unsigned int tilesX, tilesY;
+    float unitWidth, unitHeight;
     // initialize level from tile data
     void init(std::vector<std::vector<unsigned int>> tileData, unsigned int levelWidth, unsigned int levelHeight);
 };
@@ -0,0 +1,129 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include <cstddef>
+
+#include "gpu_particle_system.h"
+
+
+// layout of the command buffer, as seen by the compute shaders
+struct ParticleCommands {
+    GLuint DrawCommands[2][4];  // count, instanceCount, first, baseInstance
+    GLuint DispatchCommand[3];  // num_groups_x, y, z
+};
+
+GPUParticleSystem::GPUParticleSystem(Shader prepareShader, Shader simulateShader, Shader renderShader, Texture2D texture, unsigned int capacity)
+    : Spread(5.0f), Life(1.0f), FadeRate(2.5f), prepareShader(prepareShader), simulateShader(simulateShader), renderShader(renderShader), texture(texture), capacity(capacity), current(0), frame(0)
+{
+    this->init();
+}
+
+GPUParticleSystem::~GPUParticleSystem()
+{
+    glDeleteVertexArrays(1, &this->VAO);
+    glDeleteBuffers(1, &this->quadVBO);
+    glDeleteBuffers(2, this->particleBuffers);
+    glDeleteBuffers(1, &this->commandBuffer);
+}
+
+void GPUParticleSystem::Update(float dt, GameObject &object, unsigned int newParticles, glm::vec2 offset)
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, this->particleBuffers[this->current]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, this->particleBuffers[1 - this->current]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, this->commandBuffer);
+    // size the dispatch from the live count and reset the destination count
+    this->prepareShader.Use();
+    this->prepareShader.SetInteger("source", this->current);
+    this->prepareShader.SetInteger("emitCount", newParticles);
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    // emit, age, move and compact
+    this->simulateShader.Use();
+    this->simulateShader.SetInteger("source", this->current);
+    this->simulateShader.SetInteger("emitCount", newParticles);
+    this->simulateShader.SetInteger("capacity", this->capacity);
+    glUniform1ui(glGetUniformLocation(this->simulateShader.ID, "seed"), ++this->frame * 0x9E3779B9u);
+    this->simulateShader.SetFloat("dt", dt);
+    this->simulateShader.SetVector2f("emitterPosition", object.Position + offset);
+    this->simulateShader.SetVector2f("emitterVelocity", object.Velocity);
+    this->simulateShader.SetFloat("spread", this->Spread);
+    this->simulateShader.SetFloat("particleLife", this->Life);
+    this->simulateShader.SetFloat("fadeRate", this->FadeRate);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, this->commandBuffer);
+    glDispatchComputeIndirect(offsetof(ParticleCommands, DispatchCommand));
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+    // the survivors are read as vertex shader storage and counted by the draw command
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    this->current = 1 - this->current;
+}
+
+// render all particles
+void GPUParticleSystem::Draw()
+{
+    // use additive blending to give it a 'glow' effect
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    this->renderShader.Use();
+    this->renderShader.SetVector4f("uvRect", this->texture.UV_Rect);
+    this->texture.Bind();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, this->particleBuffers[this->current]);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->commandBuffer);
+    glBindVertexArray(this->VAO);
+    glDrawArraysIndirect(GL_TRIANGLES, (void*)(this->current * 4 * sizeof(GLuint)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    // don't forget to reset to default blending mode
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+unsigned int GPUParticleSystem::GetLiveCount() const
+{
+    // the count was written by the simulation with atomics: make those writes visible to buffer reads
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    GLuint liveCount = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->commandBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, (this->current * 4 + 1) * sizeof(GLuint), sizeof(GLuint), &liveCount);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return liveCount;
+}
+
+void GPUParticleSystem::init()
+{
+    // set up mesh and attribute properties, the per particle data is read from the storage buffer
+    float particle_quad[] = {
+        0.0f, 1.0f, 0.0f, 1.0f,
+        1.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 0.0f,
+
+        0.0f, 1.0f, 0.0f, 1.0f,
+        1.0f, 1.0f, 1.0f, 1.0f,
+        1.0f, 0.0f, 1.0f, 0.0f
+    }; 
+    glGenVertexArrays(1, &this->VAO);
+    glGenBuffers(1, &this->quadVBO);
+    glBindVertexArray(this->VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, this->quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(particle_quad), particle_quad, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    // particle buffers, only ever touched by the GPU (32 bytes per particle, see particle_simulate.cs)
+    glGenBuffers(2, this->particleBuffers);
+    for (unsigned int buffer : this->particleBuffers)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)this->capacity * 32, NULL, GL_DYNAMIC_COPY);
+    }
+    // no live particle yet, 6 vertices per particle quad
+    ParticleCommands commands = { { { 6, 0, 0, 0 }, { 6, 0, 0, 0 } }, { 0, 1, 1 } };
+    glGenBuffers(1, &this->commandBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(commands), &commands, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef GPU_PARTICLE_SYSTEM_H
+#define GPU_PARTICLE_SYSTEM_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "texture.h"
+#include "game_object.h"
+
+
+// GPUParticleSystem spawns, updates and renders particles like
+// ParticleGenerator, entirely on the GPU (OpenGL 4.3). The particles live
+// in two storage buffers used in turn: each frame a compute pass reads the
+// live particles of one buffer, emits the new ones, and appends the
+// survivors to the other buffer with an atomic counter, which is the
+// instance count of an indirect draw command. Another tiny pass sizes the
+// simulation dispatch from that counter, so the CPU only sends the emitter
+// state and never reads or writes particle data.
+class GPUParticleSystem
+{
+public:
+    // constructor, capacity is the largest number of live particles (32 bytes each, twice)
+    GPUParticleSystem(Shader prepareShader, Shader simulateShader, Shader renderShader, Texture2D texture, unsigned int capacity);
+    // destructor
+    ~GPUParticleSystem();
+    // emits newParticles at the object (with an offset) and updates all particles
+    void Update(float dt, GameObject &object, unsigned int newParticles, glm::vec2 offset = glm::vec2(0.0f, 0.0f));
+    // render all particles with an indirect draw call
+    void Draw();
+    // reads the number of live particles back, this waits for the GPU: for statistics only
+    unsigned int GetLiveCount() const;
+    unsigned int GetCapacity() const { return this->capacity; }
+    // spawn and aging parameters, the defaults are those of ParticleGenerator
+    float Spread, Life, FadeRate;
+private:
+    // render state
+    Shader prepareShader, simulateShader, renderShader;
+    Texture2D texture;
+    unsigned int capacity;
+    unsigned int VAO, quadVBO;
+    // two particle buffers, the live particles are in particleBuffers[current]
+    unsigned int particleBuffers[2];
+    unsigned int current;
+    // two DrawArraysIndirectCommand and a DispatchIndirectCommand
+    unsigned int commandBuffer;
+    unsigned int frame;
+    // initializes buffer and vertex attributes
+    void init();
+};
+
+#endif
\ No newline at end of file
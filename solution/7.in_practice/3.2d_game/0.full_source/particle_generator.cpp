@@ -6,53 +6,104 @@
 ** Creative Commons, either version 4 of the License, or (at your
 ** option) any later version.
 ******************************************************************/
+#include <algorithm>
+#include <cstddef>
+
 #include "particle_generator.h"
 
-ParticleGenerator::ParticleGenerator(Shader shader, Texture2D texture, unsigned int amount)
-    : shader(shader), texture(texture), amount(amount)
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PARTICLE_GENERATOR_SSE
+#include <xmmintrin.h>
+#endif
+
+ParticleGenerator::ParticleGenerator(Shader shader, Texture2D texture, unsigned int amount, unsigned int maxAmount)
+    : amount(amount), maxAmount(std::max(amount, maxAmount)), liveCount(0), shader(shader), texture(texture)
 {
     this->init();
 }
 
+ParticleGenerator::~ParticleGenerator()
+{
+    glDeleteVertexArrays(1, &this->VAO);
+    glDeleteBuffers(1, &this->quadVBO);
+    glDeleteBuffers(1, &this->instanceVBO);
+}
+
 void ParticleGenerator::Update(float dt, GameObject &object, unsigned int newParticles, glm::vec2 offset)
 {
     // add new particles 
-    for (unsigned int i = 0; i < newParticles; ++i)
+    unsigned int spawned = 0;
+    for (; spawned < newParticles; ++spawned)
+    {
+        unsigned int unusedParticle;
+        if (!this->spawnParticle(unusedParticle))
+            break;
+        this->respawnParticle(unusedParticle, object, offset);
+    }
+    this->stats.Spawned += spawned;
+    if (spawned < newParticles)
     {
-        int unusedParticle = this->firstUnusedParticle();
-        this->respawnParticle(this->particles[unusedParticle], object, offset);
+        this->stats.Dropped += newParticles - spawned;
+        this->stats.Exhaustions++;
     }
-    // update all particles
-    for (unsigned int i = 0; i < this->amount; ++i)
+    this->stats.PeakLive = std::max(this->stats.PeakLive, this->liveCount);
+    // update the live particles, by groups of 4 (the particles after the live ones are garbage)
+    unsigned int count = this->liveCount;
+    float *positionX = this->positionX.data(), *positionY = this->positionY.data();
+    const float *velocityX = this->velocityX.data(), *velocityY = this->velocityY.data();
+    float *alpha = this->colorA.data(), *life = this->life.data();
+#ifdef PARTICLE_GENERATOR_SSE
+    const __m128 delta = _mm_set1_ps(dt);
+    const __m128 fade = _mm_set1_ps(dt * 2.5f);
+    for (unsigned int i = 0; i < count; i += 4)
     {
-        Particle &p = this->particles[i];
-        p.Life -= dt; // reduce life
-        if (p.Life > 0.0f)
-        {	// particle is alive, thus update
-            p.Position -= p.Velocity * dt; 
-            p.Color.a -= dt * 2.5f;
+        __m128 particleLife = _mm_sub_ps(_mm_loadu_ps(life + i), delta); // reduce life
+        _mm_storeu_ps(life + i, particleLife);
+        _mm_storeu_ps(positionX + i, _mm_sub_ps(_mm_loadu_ps(positionX + i), _mm_mul_ps(_mm_loadu_ps(velocityX + i), delta)));
+        _mm_storeu_ps(positionY + i, _mm_sub_ps(_mm_loadu_ps(positionY + i), _mm_mul_ps(_mm_loadu_ps(velocityY + i), delta)));
+        _mm_storeu_ps(alpha + i, _mm_sub_ps(_mm_loadu_ps(alpha + i), fade));
+    }
+#else
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        life[i] -= dt; // reduce life
+        positionX[i] -= velocityX[i] * dt;
+        positionY[i] -= velocityY[i] * dt;
+        alpha[i] -= dt * 2.5f;
+    }
+#endif
+    // remove the dead particles and gather the live ones in the instance array
+    this->instances.clear();
+    for (unsigned int i = 0; i < this->liveCount; )
+    {
+        if (this->life[i] <= 0.0f)
+        {
+            this->killParticle(i); // the last particle moves here, check it too
+            continue;
         }
+        this->instances.push_back({ glm::vec2(this->positionX[i], this->positionY[i]), glm::vec4(this->colorR[i], this->colorG[i], this->colorB[i], this->colorA[i]) });
+        ++i;
     }
 }
 
 // render all particles
 void ParticleGenerator::Draw()
 {
+    if (this->instances.empty())
+        return;
     // use additive blending to give it a 'glow' effect
     glBlendFunc(GL_SRC_ALPHA, GL_ONE);
     this->shader.Use();
-    for (Particle particle : this->particles)
-    {
-        if (particle.Life > 0.0f)
-        {
-            this->shader.SetVector2f("offset", particle.Position);
-            this->shader.SetVector4f("color", particle.Color);
-            this->texture.Bind();
-            glBindVertexArray(this->VAO);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-            glBindVertexArray(0);
-        }
-    }
+    this->shader.SetVector4f("uvRect", this->texture.UV_Rect);
+    this->texture.Bind();
+    // stream the live particles in an orphaned buffer and draw them all at once
+    glBindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, this->amount * sizeof(ParticleInstance), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, this->instances.size() * sizeof(ParticleInstance), this->instances.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(this->VAO);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei)this->instances.size());
+    glBindVertexArray(0);
     // don't forget to reset to default blending mode
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
@@ -60,7 +111,6 @@ void ParticleGenerator::Draw()
 void ParticleGenerator::init()
 {
     // set up mesh and attribute properties
-    unsigned int VBO;
     float particle_quad[] = {
         0.0f, 1.0f, 0.0f, 1.0f,
         1.0f, 0.0f, 1.0f, 0.0f,
@@ -71,50 +121,74 @@ void ParticleGenerator::init()
         1.0f, 0.0f, 1.0f, 0.0f
     }; 
     glGenVertexArrays(1, &this->VAO);
-    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &this->quadVBO);
+    glGenBuffers(1, &this->instanceVBO);
     glBindVertexArray(this->VAO);
     // fill mesh buffer
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, this->quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(particle_quad), particle_quad, GL_STATIC_DRAW);
     // set mesh attributes
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    // per instance offset and color, streamed by Draw
+    glBindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, this->amount * sizeof(ParticleInstance), NULL, GL_STREAM_DRAW);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (void*)offsetof(ParticleInstance, Offset));
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (void*)offsetof(ParticleInstance, Color));
+    glVertexAttribDivisor(2, 1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
     // create this->amount default particle instances
-    for (unsigned int i = 0; i < this->amount; ++i)
-        this->particles.push_back(Particle());
+    this->resize(this->amount);
 }
 
-// stores the index of the last particle used (for quick access to next dead particle)
-unsigned int lastUsedParticle = 0;
-unsigned int ParticleGenerator::firstUnusedParticle()
+void ParticleGenerator::resize(unsigned int amount)
 {
-    // first search from last used particle, this will usually return almost instantly
-    for (unsigned int i = lastUsedParticle; i < this->amount; ++i){
-        if (this->particles[i].Life <= 0.0f){
-            lastUsedParticle = i;
-            return i;
-        }
-    }
-    // otherwise, do a linear search
-    for (unsigned int i = 0; i < lastUsedParticle; ++i){
-        if (this->particles[i].Life <= 0.0f){
-            lastUsedParticle = i;
-            return i;
-        }
+    this->amount = amount;
+    unsigned int paddedAmount = (amount + 3) / 4 * 4;
+    for (std::vector<float> *attribute : { &this->positionX, &this->positionY, &this->velocityX, &this->velocityY, &this->life })
+        attribute->resize(paddedAmount, 0.0f);
+    for (std::vector<float> *attribute : { &this->colorR, &this->colorG, &this->colorB, &this->colorA })
+        attribute->resize(paddedAmount, 1.0f);
+    this->instances.reserve(amount);
+}
+
+bool ParticleGenerator::spawnParticle(unsigned int &particle)
+{
+    if (this->liveCount == this->amount)
+    {
+        if (this->amount >= this->maxAmount)
+            return false;
+        // double the pool (the instance buffer follows as Draw reallocates it every frame)
+        this->resize(std::min(this->maxAmount, std::max(4u, this->amount * 2)));
+        this->stats.Grows++;
     }
-    // all particles are taken, override the first one (note that if it repeatedly hits this case, more particles should be reserved)
-    lastUsedParticle = 0;
-    return 0;
+    particle = this->liveCount++;
+    return true;
+}
+
+void ParticleGenerator::killParticle(unsigned int particle)
+{
+    unsigned int last = --this->liveCount;
+    for (std::vector<float> *attribute : { &this->positionX, &this->positionY, &this->velocityX, &this->velocityY, &this->colorR, &this->colorG, &this->colorB, &this->colorA, &this->life })
+        (*attribute)[particle] = (*attribute)[last];
 }
 
-void ParticleGenerator::respawnParticle(Particle &particle, GameObject &object, glm::vec2 offset)
+void ParticleGenerator::respawnParticle(unsigned int particle, GameObject &object, glm::vec2 offset)
 {
-    float random = ((rand() % 100) - 50) / 10.0f;
-    float rColor = 0.5f + ((rand() % 100) / 100.0f);
-    particle.Position = object.Position + random + offset;
-    particle.Color = glm::vec4(rColor, rColor, rColor, 1.0f);
-    particle.Life = 1.0f;
-    particle.Velocity = object.Velocity * 0.1f;
+    float random = ((int)this->random.NextInt(100) - 50) / 10.0f;
+    float rColor = 0.5f + (this->random.NextInt(100) / 100.0f);
+    glm::vec2 position = object.Position + random + offset;
+    glm::vec2 velocity = object.Velocity * 0.1f;
+    this->positionX[particle] = position.x;
+    this->positionY[particle] = position.y;
+    this->colorR[particle] = this->colorG[particle] = this->colorB[particle] = rColor;
+    this->colorA[particle] = 1.0f;
+    this->life[particle] = 1.0f;
+    this->velocityX[particle] = velocity.x;
+    this->velocityY[particle] = velocity.y;
 }
\ No newline at end of file
@@ -16,44 +16,87 @@
 #include "shader.h"
 #include "texture.h"
 #include "game_object.h"
+#include "random_generator.h"
 
 
-// Represents a single particle and its state
-struct Particle {
-    glm::vec2 Position, Velocity;
-    glm::vec4 Color;
-    float     Life;
+// Statistics of the particle pool of a generator, since its creation or
+// the last ResetStats
+struct ParticlePoolStats {
+    unsigned int Spawned;     // particles spawned
+    unsigned int Dropped;     // spawns dropped because the pool was full and couldn't grow
+    unsigned int Exhaustions; // updates during which the pool ran out of particles
+    unsigned int Grows;       // reallocations of the pool
+    unsigned int PeakLive;    // largest number of live particles
 
-    Particle() : Position(0.0f), Velocity(0.0f), Color(1.0f), Life(0.0f) { }
+    ParticlePoolStats() : Spawned(0), Dropped(0), Exhaustions(0), Grows(0), PeakLive(0) { }
 };
 
 
 // ParticleGenerator acts as a container for rendering a large number of 
 // particles by repeatedly spawning and updating particles and killing 
 // them after a given amount of time.
+// The particles are stored as one array per attribute (structure of
+// arrays) so that Update processes 4 particles per SSE instruction and
+// gathers the live ones in an instance buffer, drawn by Draw with a
+// single instanced draw call.
+// The live particles are always the first ones of the arrays: a new
+// particle is appended after them and a dead one is replaced by the last
+// live particle, so spawning and killing cost the same whatever the pool
+// size. When the pool is full it doubles up to maxAmount particles, past
+// that new particles are dropped and counted in the statistics.
 class ParticleGenerator
 {
 public:
-    // constructor
-    ParticleGenerator(Shader shader, Texture2D texture, unsigned int amount);
+    // constructor, the pool starts with amount particles and may grow up to maxAmount (no growth if maxAmount <= amount)
+    ParticleGenerator(Shader shader, Texture2D texture, unsigned int amount, unsigned int maxAmount = 0);
+    // destructor
+    ~ParticleGenerator();
     // update all particles
     void Update(float dt, GameObject &object, unsigned int newParticles, glm::vec2 offset = glm::vec2(0.0f, 0.0f));
     // render all particles
     void Draw();
+    // number of particles alive after the last update
+    unsigned int GetLiveCount() const { return this->liveCount; }
+    // current size of the pool
+    unsigned int GetAmount() const { return this->amount; }
+    // pool statistics
+    const ParticlePoolStats &GetStats() const { return this->stats; }
+    void ResetStats() { this->stats = ParticlePoolStats(); }
+    // restarts the random sequence of the respawned particles
+    void Seed(uint64_t seed) { this->random.Seed(seed); }
 private:
-    // state
-    std::vector<Particle> particles;
-    unsigned int amount;
+    // per instance data of a live particle
+    struct ParticleInstance {
+        glm::vec2 Offset;
+        glm::vec4 Color;
+    };
+    // state: one array per particle attribute, padded to a multiple of 4 particles.
+    // The particles [0, liveCount) are alive
+    std::vector<float> positionX, positionY;
+    std::vector<float> velocityX, velocityY;
+    std::vector<float> colorR, colorG, colorB, colorA;
+    std::vector<float> life;
+    unsigned int amount, maxAmount;
+    unsigned int liveCount;
+    ParticlePoolStats stats;
+    RandomGenerator random;
+    // live particles, compacted by Update
+    std::vector<ParticleInstance> instances;
     // render state
     Shader shader;
     Texture2D texture;
     unsigned int VAO;
+    unsigned int quadVBO, instanceVBO;
     // initializes buffer and vertex attributes
     void init();
-    // returns the first Particle index that's currently unused e.g. Life <= 0.0f or 0 if no particle is currently inactive
-    unsigned int firstUnusedParticle();
+    // resizes the attribute arrays to hold amount particles
+    void resize(unsigned int amount);
+    // allocates the particle after the live ones, growing the pool if needed. Returns false if the pool is full
+    bool spawnParticle(unsigned int &particle);
+    // replaces a dead particle by the last live one
+    void killParticle(unsigned int particle);
     // respawns particle
-    void respawnParticle(Particle &particle, GameObject &object, glm::vec2 offset = glm::vec2(0.0f, 0.0f));
+    void respawnParticle(unsigned int particle, GameObject &object, glm::vec2 offset = glm::vec2(0.0f, 0.0f));
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,33 @@
+#version 430 core
+layout (location = 0) in vec4 vertex; // <vec2 position, vec2 texCoords>
+
+out vec2 TexCoords;
+out vec4 ParticleColor;
+
+// the live particles written by particle_simulate.cs, one instance each
+struct Particle
+{
+    vec2 position;
+    vec2 velocity;
+    uint colorRG;
+    uint colorBA;
+    float life;
+    float padding;
+};
+
+layout (std430, binding = 0) readonly buffer Particles
+{
+    Particle particles[];
+};
+
+uniform mat4 projection;
+uniform vec4 uvRect; // part of the texture holding the particle sprite
+
+void main()
+{
+    float scale = 10.0f;
+    Particle particle = particles[gl_InstanceID];
+    TexCoords = mix(uvRect.xy, uvRect.zw, vertex.zw);
+    ParticleColor = vec4(unpackHalf2x16(particle.colorRG), unpackHalf2x16(particle.colorBA));
+    gl_Position = projection * vec4((vertex.xy * scale) + particle.position, 0.0, 1.0);
+}
@@ -0,0 +1,24 @@
+#version 430 core
+layout (local_size_x = 1) in;
+
+// draw commands of the two particle buffers (count, instanceCount, first, baseInstance),
+// their instanceCount is the number of live particles, then the arguments of the simulation dispatch
+layout (std430, binding = 2) buffer Commands
+{
+    uint drawCommands[8];
+    uint dispatchCommand[3];
+};
+
+uniform int source;     // particle buffer read by the next simulation
+uniform int emitCount;  // particles emitted by the next simulation
+
+void main()
+{
+    // one thread per live particle of the source buffer and per emitted particle
+    uint threads = drawCommands[source * 4 + 1] + uint(emitCount);
+    dispatchCommand[0] = (threads + 63u) / 64u;
+    dispatchCommand[1] = 1u;
+    dispatchCommand[2] = 1u;
+    // the simulation counts the survivors in the other buffer
+    drawCommands[(1 - source) * 4 + 1] = 0u;
+}
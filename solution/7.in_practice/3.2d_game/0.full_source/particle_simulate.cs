@@ -0,0 +1,96 @@
+#version 430 core
+layout (local_size_x = 64) in;
+
+// 32 bytes per particle: the color is stored as half floats (its components go above 1.0)
+struct Particle
+{
+    vec2 position;
+    vec2 velocity;
+    uint colorRG;
+    uint colorBA;
+    float life;
+    float padding;
+};
+
+layout (std430, binding = 0) readonly buffer SourceParticles
+{
+    Particle sourceParticles[];
+};
+
+layout (std430, binding = 1) writeonly buffer DestinationParticles
+{
+    Particle destinationParticles[];
+};
+
+layout (std430, binding = 2) buffer Commands
+{
+    uint drawCommands[8];
+    uint dispatchCommand[3];
+};
+
+uniform int source;
+uniform int emitCount;
+uniform int capacity;
+uniform uint seed;      // changes every frame
+uniform float dt;
+// emitter, same behaviour as ParticleGenerator::respawnParticle
+uniform vec2 emitterPosition;
+uniform vec2 emitterVelocity;
+uniform float spread;   // half size of the square the particles spawn in
+uniform float particleLife;
+uniform float fadeRate; // alpha lost per second
+
+// hash of the frame seed and the thread, then steps of the same generator
+uint random(inout uint state)
+{
+    state = state * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+float random01(inout uint state)
+{
+    return float(random(state) >> 8) / 16777216.0;
+}
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    uint live = drawCommands[source * 4 + 1];
+    Particle particle;
+    if (i < live)
+    {
+        particle = sourceParticles[i];
+    }
+    else if (i < live + uint(emitCount))
+    {
+        uint state = seed ^ (i * 2654435761u);
+        float offset = (random01(state) * 2.0 - 1.0) * spread;
+        float color = 0.5 + random01(state);
+        particle.position = emitterPosition + offset;
+        particle.velocity = emitterVelocity * 0.1;
+        particle.colorRG = packHalf2x16(vec2(color));
+        particle.colorBA = packHalf2x16(vec2(color, 1.0));
+        particle.life = particleLife;
+        particle.padding = 0.0;
+    }
+    else
+        return;
+
+    // age and move, dead particles are not copied: the destination buffer only holds the survivors
+    particle.life -= dt;
+    if (particle.life <= 0.0)
+        return;
+    particle.position -= particle.velocity * dt;
+    vec2 colorBA = unpackHalf2x16(particle.colorBA);
+    particle.colorBA = packHalf2x16(vec2(colorBA.x, colorBA.y - dt * fadeRate));
+
+    uint index = atomicAdd(drawCommands[(1 - source) * 4 + 1], 1u);
+    if (index >= uint(capacity))
+    {
+        // full: the particle is dropped and the count given back
+        atomicAdd(drawCommands[(1 - source) * 4 + 1], 0xFFFFFFFFu);
+        return;
+    }
+    destinationParticles[index] = particle;
+}
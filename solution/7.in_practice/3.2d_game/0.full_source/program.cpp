@@ -12,6 +12,7 @@
 #include "game.h"
 #include "resource_manager.h"
 
+#include <algorithm>
 #include <iostream>
 
 // GLFW function declarations
@@ -28,7 +29,8 @@ Game Breakout(SCREEN_WIDTH, SCREEN_HEIGHT);
 int main(int argc, char *argv[])
 {
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    // compute shaders need OpenGL 4.3
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, GPU_PARTICLES ? 4 : 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 #ifdef __APPLE__
@@ -64,6 +66,8 @@ int main(int argc, char *argv[])
     // -------------------
     float deltaTime = 0.0f;
     float lastFrame = 0.0f;
+    // frame time not simulated yet
+    float accumulator = 0.0f;
 
     while (!glfwWindowShouldClose(window))
     {
@@ -74,19 +78,20 @@ int main(int argc, char *argv[])
         lastFrame = currentFrame;
         glfwPollEvents();
 
-        // manage user input
-        // -----------------
-        Breakout.ProcessInput(deltaTime);
-
-        // update game state
-        // -----------------
-        Breakout.Update(deltaTime);
+        // manage user input and update game state, in fixed steps
+        // -------------------------------------------------------
+        accumulator += std::min(deltaTime, MAX_FRAME_TIME);
+        while (accumulator >= SIMULATION_STEP)
+        {
+            Breakout.Step(SIMULATION_STEP);
+            accumulator -= SIMULATION_STEP;
+        }
 
-        // render
-        // ------
+        // render, between the last two steps by the time left in the accumulator
+        // ------------------------------------------------------------------------
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
-        Breakout.Render();
+        Breakout.Render(accumulator / SIMULATION_STEP);
 
         glfwSwapBuffers(window);
     }
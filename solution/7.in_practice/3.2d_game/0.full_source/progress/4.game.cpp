@@ -93,5 +93,6 @@ void Game::Render()
         this->Levels[this->Level].Draw(*Renderer);
         // draw player
         Player->Draw(*Renderer);
+        Renderer->Flush();
     }
 }
\ No newline at end of file
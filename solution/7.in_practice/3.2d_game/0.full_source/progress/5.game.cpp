@@ -119,6 +119,7 @@ void Game::Render()
         Player->Draw(*Renderer);
         // draw ball
         Ball->Draw(*Renderer);            
+        Renderer->Flush();
     }
 }
 
@@ -127,10 +127,13 @@ void Game::Render()
         this->Levels[this->Level].Draw(*Renderer);
         // draw player
         Player->Draw(*Renderer);
+        // particles use their own shader: draw the sprites batched so far first
+        Renderer->Flush();
         // draw particles	
         Particles->Draw();
         // draw ball
         Ball->Draw(*Renderer);            
+        Renderer->Flush();
     }
 }
 
@@ -143,10 +143,13 @@ void Game::Render()
             this->Levels[this->Level].Draw(*Renderer);
             // draw player
             Player->Draw(*Renderer);           
+            // particles use their own shader: draw the sprites batched so far first
+            Renderer->Flush();
             // draw particles	
             Particles->Draw();
             // draw ball
             Ball->Draw(*Renderer);            
+            Renderer->Flush();
         // end rendering to postprocessing framebuffer
         Effects->EndRender();
         // render postprocessing quad
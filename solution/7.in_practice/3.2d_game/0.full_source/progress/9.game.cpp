@@ -164,10 +164,13 @@ void Game::Render()
             for (PowerUp &powerUp : this->PowerUps)
                 if (!powerUp.Destroyed)
                     powerUp.Draw(*Renderer);            
+            // particles use their own shader: draw the sprites batched so far first
+            Renderer->Flush();
             // draw particles	
             Particles->Draw();
             // draw ball
             Ball->Draw(*Renderer);            
+            Renderer->Flush();
         // end rendering to postprocessing framebuffer
         Effects->EndRender();
         // render postprocessing quad
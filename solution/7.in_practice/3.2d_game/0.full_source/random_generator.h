@@ -0,0 +1,48 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef RANDOM_GENERATOR_H
+#define RANDOM_GENERATOR_H
+#include <cstdint>
+
+
+// RandomGenerator is a small seeded pseudo random number generator
+// (PCG32). Unlike rand() its sequence is the same on every platform
+// and isn't shared with other code, so a simulation seeded with the
+// same value always makes the same random choices.
+class RandomGenerator
+{
+public:
+    // constructor
+    RandomGenerator(uint64_t seed = 1) { this->Seed(seed); }
+    // restarts the sequence of the given seed
+    void Seed(uint64_t seed)
+    {
+        this->state = 0;
+        this->Next();
+        this->state += seed;
+        this->Next();
+    }
+    // returns 32 random bits
+    uint32_t Next()
+    {
+        uint64_t old = this->state;
+        this->state = old * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t xorShifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+        uint32_t rotation = (uint32_t)(old >> 59u);
+        return (xorShifted >> rotation) | (xorShifted << ((32u - rotation) & 31u));
+    }
+    // returns an integer in [0, range)
+    unsigned int NextInt(unsigned int range) { return this->Next() % range; }
+    // returns a float in [0, 1)
+    float NextFloat() { return (this->Next() >> 8) * (1.0f / 16777216.0f); }
+private:
+    uint64_t state;
+};
+
+#endif
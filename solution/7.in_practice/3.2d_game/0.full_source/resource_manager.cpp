@@ -11,12 +11,19 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <algorithm>
+#include <set>
 
 #include "stb_image.h"
 
 // Instantiate static variables
 std::map<std::string, Texture2D>    ResourceManager::Textures;
 std::map<std::string, Shader>       ResourceManager::Shaders;
+std::vector<ResourceManager::AtlasImage> ResourceManager::atlasQueue;
+
+// atlas cache header: "BATL" and the version of the format
+const unsigned int ATLAS_CACHE_MAGIC = 0x4c544142;
+const unsigned int ATLAS_CACHE_VERSION = 1;
 
 
 Shader ResourceManager::LoadShader(const char *vShaderFile, const char *fShaderFile, const char *gShaderFile, std::string name)
@@ -25,6 +32,22 @@ Shader ResourceManager::LoadShader(const char *vShaderFile, const char *fShaderF
     return Shaders[name];
 }
 
+Shader ResourceManager::LoadComputeShader(const char *cShaderFile, std::string name)
+{
+    // retrieve the compute shader code from filePath
+    std::ifstream computeShaderFile(cShaderFile);
+    std::stringstream cShaderStream;
+    cShaderStream << computeShaderFile.rdbuf();
+    if (!computeShaderFile)
+        std::cout << "ERROR::SHADER: Failed to read shader file " << cShaderFile << std::endl;
+    std::string computeCode = cShaderStream.str();
+    // create the program
+    Shader shader;
+    shader.CompileCompute(computeCode.c_str());
+    Shaders[name] = shader;
+    return shader;
+}
+
 Shader ResourceManager::GetShader(std::string name)
 {
     return Shaders[name];
@@ -41,14 +64,65 @@ Texture2D ResourceManager::GetTexture(std::string name)
     return Textures[name];
 }
 
+void ResourceManager::QueueAtlasTexture(const char *file, bool alpha, std::string name)
+{
+    AtlasImage image;
+    image.File = file;
+    image.Alpha = alpha;
+    image.Name = name;
+    std::ifstream imageFile(file, std::ios::binary | std::ios::ate);
+    image.FileSize = imageFile ? (long long)imageFile.tellg() : -1;
+    atlasQueue.push_back(image);
+}
+
+void ResourceManager::LoadAtlas(unsigned int pageSize, unsigned int padding, const char *cacheFile)
+{
+    std::vector<unsigned int> pageHeights;
+    std::vector<std::vector<unsigned char>> pages;
+    if (cacheFile == nullptr || !readAtlasCache(cacheFile, pageSize, padding, pageHeights, pages))
+    {
+        packAtlas(pageSize, padding, pageHeights, pages);
+        if (cacheFile != nullptr)
+            writeAtlasCache(cacheFile, pageSize, padding, pageHeights, pages);
+    }
+
+    // one texture object per page, clamped as the padding already extends the borders of the images
+    std::vector<Texture2D> pageTextures;
+    for (unsigned int i = 0; i < pages.size(); ++i)
+    {
+        Texture2D page;
+        page.Internal_Format = GL_RGBA;
+        page.Image_Format = GL_RGBA;
+        page.Wrap_S = GL_CLAMP_TO_EDGE;
+        page.Wrap_T = GL_CLAMP_TO_EDGE;
+        page.Generate(pageSize, pageHeights[i], pages[i].data());
+        pageTextures.push_back(page);
+    }
+    for (const AtlasImage &image : atlasQueue)
+    {
+        if (image.Region.Width == 0)
+            continue;
+        Texture2D texture = pageTextures[image.Region.Page];
+        float pageHeight = (float)pageHeights[image.Region.Page];
+        texture.Width = image.Region.Width;
+        texture.Height = image.Region.Height;
+        texture.UV_Rect = glm::vec4(image.Region.X / (float)pageSize, image.Region.Y / pageHeight, (image.Region.X + image.Region.Width) / (float)pageSize, (image.Region.Y + image.Region.Height) / pageHeight);
+        Textures[image.Name] = texture;
+    }
+    atlasQueue.clear();
+}
+
 void ResourceManager::Clear()
 {
     // (properly) delete all shaders	
     for (auto iter : Shaders)
         glDeleteProgram(iter.second.ID);
-    // (properly) delete all textures
+    // (properly) delete all textures, once for the textures sharing an atlas page
+    std::set<unsigned int> textureIDs;
     for (auto iter : Textures)
-        glDeleteTextures(1, &iter.second.ID);
+        textureIDs.insert(iter.second.ID);
+    for (unsigned int ID : textureIDs)
+        glDeleteTextures(1, &ID);
 }
 
 Shader ResourceManager::loadShaderFromFile(const char *vShaderFile, const char *fShaderFile, const char *gShaderFile)
@@ -112,4 +186,152 @@ Texture2D ResourceManager::loadTextureFromFile(const char *file, bool alpha)
     // and finally free image data
     stbi_image_free(data);
     return texture;
+}
+
+void ResourceManager::packAtlas(unsigned int pageSize, unsigned int padding, std::vector<unsigned int> &pageHeights, std::vector<std::vector<unsigned char>> &pages)
+{
+    // decode every image as RGBA, images without alpha are opaque whatever their file holds
+    std::vector<unsigned char*> pixels(atlasQueue.size());
+    for (unsigned int i = 0; i < atlasQueue.size(); ++i)
+    {
+        AtlasImage &image = atlasQueue[i];
+        int width = 0, height = 0, nrChannels;
+        pixels[i] = stbi_load(image.File.c_str(), &width, &height, &nrChannels, 4);
+        if (!pixels[i])
+        {
+            std::cout << "ERROR::ATLAS: Failed to load " << image.File << std::endl;
+            width = height = 0;
+        }
+        else if (!image.Alpha)
+            for (int p = 0; p < width * height; ++p)
+                pixels[i][p * 4 + 3] = 255;
+        image.Region.Page = 0;
+        image.Region.X = image.Region.Y = 0;
+        image.Region.Width = width;
+        image.Region.Height = height;
+    }
+
+    // tallest first: the skyline stays flat and the pages are filled tighter
+    std::vector<unsigned int> order;
+    for (unsigned int i = 0; i < atlasQueue.size(); ++i)
+        if (pixels[i])
+            order.push_back(i);
+    std::stable_sort(order.begin(), order.end(), [](unsigned int a, unsigned int b) { return atlasQueue[a].Region.Height > atlasQueue[b].Region.Height; });
+    TextureAtlas atlas(pageSize, padding);
+    for (unsigned int i : order)
+    {
+        AtlasImage &image = atlasQueue[i];
+        if (!atlas.Pack(image.Region.Width, image.Region.Height, image.Region))
+        {
+            std::cout << "ERROR::ATLAS: " << image.File << " is larger than an atlas page, load it with LoadTexture" << std::endl;
+            image.Region.Width = image.Region.Height = 0;
+        }
+    }
+
+    // the pages are cut to their filled height
+    pageHeights.resize(atlas.GetPageCount());
+    pages.resize(atlas.GetPageCount());
+    for (unsigned int i = 0; i < atlas.GetPageCount(); ++i)
+    {
+        pageHeights[i] = atlas.GetUsedHeight(i);
+        pages[i].assign((size_t)pageSize * pageHeights[i] * 4, 0);
+    }
+    for (unsigned int i : order)
+    {
+        const TextureAtlas::Region &region = atlasQueue[i].Region;
+        if (region.Width == 0)
+            continue;
+        // copy the image and extrude its edges over the padding: filtering at the borders reads the image itself
+        unsigned char *page = pages[region.Page].data();
+        for (unsigned int y = region.Y - padding; y < region.Y + region.Height + padding; ++y)
+        {
+            unsigned int sourceY = std::min(std::max(y, region.Y), region.Y + region.Height - 1) - region.Y;
+            for (unsigned int x = region.X - padding; x < region.X + region.Width + padding; ++x)
+            {
+                unsigned int sourceX = std::min(std::max(x, region.X), region.X + region.Width - 1) - region.X;
+                const unsigned char *source = pixels[i] + (sourceY * region.Width + sourceX) * 4;
+                std::copy(source, source + 4, page + ((size_t)y * pageSize + x) * 4);
+            }
+        }
+    }
+    for (unsigned char *data : pixels)
+        if (data)
+            stbi_image_free(data);
+}
+
+bool ResourceManager::readAtlasCache(const char *cacheFile, unsigned int pageSize, unsigned int padding, std::vector<unsigned int> &pageHeights, std::vector<std::vector<unsigned char>> &pages)
+{
+    std::ifstream in(cacheFile, std::ios::binary);
+    unsigned int header[5];
+    if (!in.read((char*)header, sizeof(header)))
+        return false;
+    // the cache is only valid for the same settings and the same queued files (names, paths and sizes)
+    if (header[0] != ATLAS_CACHE_MAGIC || header[1] != ATLAS_CACHE_VERSION || header[2] != pageSize || header[3] != padding || header[4] != atlasQueue.size())
+        return false;
+    std::vector<TextureAtlas::Region> regions(atlasQueue.size());
+    for (unsigned int i = 0; i < atlasQueue.size(); ++i)
+    {
+        const AtlasImage &image = atlasQueue[i];
+        unsigned int nameLength = 0, fileLength = 0;
+        if (!in.read((char*)&nameLength, sizeof(nameLength)) || !in.read((char*)&fileLength, sizeof(fileLength)) || nameLength != image.Name.size() || fileLength != image.File.size())
+            return false;
+        std::string name(nameLength, '\0'), file(fileLength, '\0');
+        bool alpha;
+        long long fileSize;
+        if (!in.read(&name[0], nameLength) || !in.read(&file[0], fileLength) || !in.read((char*)&alpha, sizeof(alpha)) || !in.read((char*)&fileSize, sizeof(fileSize)) || !in.read((char*)&regions[i], sizeof(TextureAtlas::Region)))
+            return false;
+        if (name != image.Name || file != image.File || alpha != image.Alpha || fileSize != image.FileSize)
+            return false;
+    }
+    unsigned int pageCount = 0;
+    if (!in.read((char*)&pageCount, sizeof(pageCount)))
+        return false;
+    pageHeights.resize(pageCount);
+    pages.resize(pageCount);
+    for (unsigned int i = 0; i < pageCount; ++i)
+    {
+        if (!in.read((char*)&pageHeights[i], sizeof(unsigned int)) || pageHeights[i] > pageSize)
+            return false;
+        pages[i].resize((size_t)pageSize * pageHeights[i] * 4);
+        if (!pages[i].empty() && !in.read((char*)pages[i].data(), pages[i].size()))
+            return false;
+    }
+    // a stale or corrupted cache must not point outside its pages (regions without width are the images not packed)
+    for (const TextureAtlas::Region &region : regions)
+    {
+        if (region.Width == 0)
+            continue;
+        if (region.Page >= pageCount || region.X > pageSize || region.Width > pageSize - region.X || region.Y > pageHeights[region.Page] || region.Height > pageHeights[region.Page] - region.Y)
+            return false;
+    }
+    for (unsigned int i = 0; i < atlasQueue.size(); ++i)
+        atlasQueue[i].Region = regions[i];
+    return true;
+}
+
+void ResourceManager::writeAtlasCache(const char *cacheFile, unsigned int pageSize, unsigned int padding, const std::vector<unsigned int> &pageHeights, const std::vector<std::vector<unsigned char>> &pages)
+{
+    std::ofstream out(cacheFile, std::ios::binary);
+    if (!out)
+        return;
+    unsigned int header[5] = { ATLAS_CACHE_MAGIC, ATLAS_CACHE_VERSION, pageSize, padding, (unsigned int)atlasQueue.size() };
+    out.write((const char*)header, sizeof(header));
+    for (const AtlasImage &image : atlasQueue)
+    {
+        unsigned int nameLength = (unsigned int)image.Name.size(), fileLength = (unsigned int)image.File.size();
+        out.write((const char*)&nameLength, sizeof(nameLength));
+        out.write((const char*)&fileLength, sizeof(fileLength));
+        out.write(image.Name.data(), nameLength);
+        out.write(image.File.data(), fileLength);
+        out.write((const char*)&image.Alpha, sizeof(image.Alpha));
+        out.write((const char*)&image.FileSize, sizeof(image.FileSize));
+        out.write((const char*)&image.Region, sizeof(TextureAtlas::Region));
+    }
+    unsigned int pageCount = (unsigned int)pages.size();
+    out.write((const char*)&pageCount, sizeof(pageCount));
+    for (unsigned int i = 0; i < pageCount; ++i)
+    {
+        out.write((const char*)&pageHeights[i], sizeof(unsigned int));
+        out.write((const char*)pages[i].data(), pages[i].size());
+    }
 }
\ No newline at end of file
@@ -11,10 +11,12 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include <glad/glad.h>
 
 #include "texture.h"
+#include "texture_atlas.h"
 #include "shader.h"
 
 
@@ -23,6 +25,10 @@
 // and/or shader is also stored for future reference by string
 // handles. All functions and resources are static and no 
 // public constructor is defined.
+// Small textures can be packed in atlas pages: they are queued by
+// QueueAtlasTexture and packed by LoadAtlas, after which GetTexture
+// returns the page texture with the UV rectangle of the image, so
+// sprites of different images share one texture object.
 class ResourceManager
 {
 public:
@@ -31,12 +37,18 @@ public:
     static std::map<std::string, Texture2D> Textures;
     // loads (and generates) a shader program from file loading vertex, fragment (and geometry) shader's source code. If gShaderFile is not nullptr, it also loads a geometry shader
     static Shader    LoadShader(const char *vShaderFile, const char *fShaderFile, const char *gShaderFile, std::string name);
+    // loads (and generates) a compute shader program from file (requires OpenGL 4.3)
+    static Shader    LoadComputeShader(const char *cShaderFile, std::string name);
     // retrieves a stored sader
     static Shader    GetShader(std::string name);
     // loads (and generates) a texture from file
     static Texture2D LoadTexture(const char *file, bool alpha, std::string name);
     // retrieves a stored texture
     static Texture2D GetTexture(std::string name);
+    // queues a texture to be packed in an atlas by LoadAtlas instead of getting a texture object of its own
+    static void      QueueAtlasTexture(const char *file, bool alpha, std::string name);
+    // packs the queued textures in pages of pageSize x pageSize pixels, each image surrounded by padding pixels of its extruded edges. If cacheFile is not nullptr, the pages are read from it when it was written for the same files and settings, and written to it otherwise
+    static void      LoadAtlas(unsigned int pageSize = 2048, unsigned int padding = 2, const char *cacheFile = nullptr);
     // properly de-allocates all loaded resources
     static void      Clear();
 private:
@@ -46,6 +58,20 @@ private:
     static Shader    loadShaderFromFile(const char *vShaderFile, const char *fShaderFile, const char *gShaderFile = nullptr);
     // loads a single texture from file
     static Texture2D loadTextureFromFile(const char *file, bool alpha);
+    // a texture waiting for LoadAtlas
+    struct AtlasImage {
+        std::string File;
+        bool        Alpha;
+        std::string Name;
+        long long   FileSize;
+        TextureAtlas::Region Region;
+    };
+    static std::vector<AtlasImage> atlasQueue;
+    // packs the queued images and fills the RGBA pixels of the pages
+    static void      packAtlas(unsigned int pageSize, unsigned int padding, std::vector<unsigned int> &pageHeights, std::vector<std::vector<unsigned char>> &pages);
+    // reads the pages and regions of a cache written for the queued images, returns false if there is none
+    static bool      readAtlasCache(const char *cacheFile, unsigned int pageSize, unsigned int padding, std::vector<unsigned int> &pageHeights, std::vector<std::vector<unsigned char>> &pages);
+    static void      writeAtlasCache(const char *cacheFile, unsigned int pageSize, unsigned int padding, const std::vector<unsigned int> &pageHeights, const std::vector<std::vector<unsigned char>> &pages);
 };
 
 #endif
\ No newline at end of file
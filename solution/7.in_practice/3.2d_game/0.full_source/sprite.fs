@@ -1,12 +1,12 @@
 #version 330 core
 in vec2 TexCoords;
+in vec3 SpriteColor;
 out vec4 color;
 
 uniform sampler2D sprite;
-uniform vec3 spriteColor;
 
 void main()
 {
     
-    color = vec4(spriteColor, 1.0) * texture(sprite, TexCoords);
-}
\ No newline at end of file
+    color = vec4(SpriteColor, 1.0) * texture(sprite, TexCoords);
+}
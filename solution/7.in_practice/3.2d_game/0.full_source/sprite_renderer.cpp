@@ -8,8 +8,12 @@
 ******************************************************************/
 #include "sprite_renderer.h"
 
+#include <cmath>
+#include <cstddef>
+
 
 SpriteRenderer::SpriteRenderer(Shader &shader)
+    : batchTexture(0), drawCalls(0), spriteCount(0)
 {
     this->shader = shader;
     this->initRenderData();
@@ -18,58 +22,92 @@ SpriteRenderer::SpriteRenderer(Shader &shader)
 SpriteRenderer::~SpriteRenderer()
 {
     glDeleteVertexArrays(1, &this->quadVAO);
+    glDeleteBuffers(1, &this->VBO);
+    glDeleteBuffers(1, &this->EBO);
 }
 
-void SpriteRenderer::DrawSprite(Texture2D &texture, glm::vec2 position, glm::vec2 size, float rotate, glm::vec3 color)
+void SpriteRenderer::DrawSprite(Texture2D &texture, glm::vec2 position, glm::vec2 size, float rotate, glm::vec3 color, glm::vec4 uvRect)
 {
-    // prepare transformations
-    this->shader.Use();
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(position, 0.0f));  // first translate (transformations are: scale happens first, then rotation, and then final translation happens; reversed order)
-
-    model = glm::translate(model, glm::vec3(0.5f * size.x, 0.5f * size.y, 0.0f)); // move origin of rotation to center of quad
-    model = glm::rotate(model, glm::radians(rotate), glm::vec3(0.0f, 0.0f, 1.0f)); // then rotate
-    model = glm::translate(model, glm::vec3(-0.5f * size.x, -0.5f * size.y, 0.0f)); // move origin back
-
-    model = glm::scale(model, glm::vec3(size, 1.0f)); // last scale
+    // a batch holds the sprites of one texture
+    if (texture.ID != this->batchTexture || this->vertices.size() >= MAX_BATCH_SPRITES * 4)
+    {
+        this->Flush();
+        this->batchTexture = texture.ID;
+    }
 
-    this->shader.SetMatrix4("model", model);
+    // same transformations as a model matrix: scale first, then rotation around the center of the quad, then translation
+    glm::vec2 halfSize = 0.5f * size;
+    glm::vec2 center = position + halfSize;
+    float angle = glm::radians(rotate);
+    float cosAngle = std::cos(angle), sinAngle = std::sin(angle);
+    // sprites packed in an atlas only cover a part of the texture
+    glm::vec2 textureUV = glm::vec2(texture.UV_Rect.x, texture.UV_Rect.y);
+    glm::vec2 textureSize = glm::vec2(texture.UV_Rect.z, texture.UV_Rect.w) - textureUV;
+    glm::vec4 uv = glm::vec4(textureUV + glm::vec2(uvRect.x, uvRect.y) * textureSize, textureUV + glm::vec2(uvRect.z, uvRect.w) * textureSize);
+    const glm::vec2 corners[4] = { glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 0.0f), glm::vec2(1.0f, 1.0f), glm::vec2(0.0f, 1.0f) };
+    for (const glm::vec2 &corner : corners)
+    {
+        glm::vec2 local = corner * size - halfSize;
+        SpriteVertex vertex;
+        vertex.Position = center + glm::vec2(cosAngle * local.x - sinAngle * local.y, sinAngle * local.x + cosAngle * local.y);
+        vertex.TexCoords = glm::vec2(uv.x, uv.y) + corner * glm::vec2(uv.z - uv.x, uv.w - uv.y);
+        vertex.Color = color;
+        this->vertices.push_back(vertex);
+    }
+    this->spriteCount++;
+}
 
-    // render textured quad
-    this->shader.SetVector3f("spriteColor", color);
+void SpriteRenderer::Flush()
+{
+    if (this->vertices.empty())
+        return;
 
+    this->shader.Use();
     glActiveTexture(GL_TEXTURE0);
-    texture.Bind();
+    glBindTexture(GL_TEXTURE_2D, this->batchTexture);
+
+    // orphan the buffer: the driver gives a new storage instead of waiting for the draws of the previous batch
+    glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+    glBufferData(GL_ARRAY_BUFFER, MAX_BATCH_SPRITES * 4 * sizeof(SpriteVertex), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, this->vertices.size() * sizeof(SpriteVertex), this->vertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     glBindVertexArray(this->quadVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glDrawElements(GL_TRIANGLES, (GLsizei)(this->vertices.size() / 4 * 6), GL_UNSIGNED_SHORT, 0);
     glBindVertexArray(0);
+
+    this->vertices.clear();
+    this->drawCalls++;
 }
 
 void SpriteRenderer::initRenderData()
 {
-    // configure VAO/VBO
-    unsigned int VBO;
-    float vertices[] = { 
-        // pos      // tex
-        0.0f, 1.0f, 0.0f, 1.0f,
-        1.0f, 0.0f, 1.0f, 0.0f,
-        0.0f, 0.0f, 0.0f, 0.0f, 
-
-        0.0f, 1.0f, 0.0f, 1.0f,
-        1.0f, 1.0f, 1.0f, 1.0f,
-        1.0f, 0.0f, 1.0f, 0.0f
-    };
+    // configure VAO/VBO: the vertices are streamed by Flush, the indices of the quads never change
+    std::vector<unsigned short> indices;
+    indices.reserve(MAX_BATCH_SPRITES * 6);
+    for (unsigned int i = 0; i < MAX_BATCH_SPRITES; ++i)
+    {
+        unsigned short first = (unsigned short)(i * 4);
+        unsigned short quad[] = { first, (unsigned short)(first + 2), (unsigned short)(first + 1), first, (unsigned short)(first + 3), (unsigned short)(first + 2) };
+        indices.insert(indices.end(), quad, quad + 6);
+    }
+    this->vertices.reserve(MAX_BATCH_SPRITES * 4);
 
     glGenVertexArrays(1, &this->quadVAO);
-    glGenBuffers(1, &VBO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glGenBuffers(1, &this->VBO);
+    glGenBuffers(1, &this->EBO);
 
     glBindVertexArray(this->quadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+    glBufferData(GL_ARRAY_BUFFER, MAX_BATCH_SPRITES * 4 * sizeof(SpriteVertex), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), indices.data(), GL_STATIC_DRAW);
+
+    // <vec2 position, vec2 texCoords> as before, then the color of the sprite
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, Color));
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 }
\ No newline at end of file
@@ -9,6 +9,8 @@
 #ifndef SPRITE_RENDERER_H
 #define SPRITE_RENDERER_H
 
+#include <vector>
+
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -17,19 +19,44 @@
 #include "shader.h"
 
 
+// SpriteRenderer collects the sprites drawn with DrawSprite as quads in a
+// vertex buffer and draws all the consecutive sprites sharing a texture with
+// a single draw call. A batch is flushed when the texture changes, when the
+// buffer is full or by Flush, which must be called before anything else is
+// drawn (other shaders, framebuffer changes) and at the end of the frame.
 class SpriteRenderer
 {
 public:
+    // maximum number of sprites per draw call
+    static const unsigned int MAX_BATCH_SPRITES = 1024;
     // Constructor (inits shaders/shapes)
     SpriteRenderer(Shader &shader);
     // Destructor
     ~SpriteRenderer();
-    // Renders a defined quad textured with given sprite
-    void DrawSprite(Texture2D &texture, glm::vec2 position, glm::vec2 size = glm::vec2(10.0f, 10.0f), float rotate = 0.0f, glm::vec3 color = glm::vec3(1.0f));
+    // Adds a quad textured with the uvRect (u0, v0, u1, v1) part of the given sprite to the batch, relative to the texture's own UV rectangle
+    void DrawSprite(Texture2D &texture, glm::vec2 position, glm::vec2 size = glm::vec2(10.0f, 10.0f), float rotate = 0.0f, glm::vec3 color = glm::vec3(1.0f), glm::vec4 uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+    // Draws the pending sprites
+    void Flush();
+    // statistics since the last ResetStats
+    unsigned int GetDrawCalls() const { return this->drawCalls; }
+    unsigned int GetSpriteCount() const { return this->spriteCount; }
+    void ResetStats() { this->drawCalls = this->spriteCount = 0; }
 private:
+    // vertex of a sprite quad, already transformed to screen space on the CPU
+    struct SpriteVertex {
+        glm::vec2 Position;
+        glm::vec2 TexCoords;
+        glm::vec3 Color;
+    };
     // Render state
     Shader       shader; 
     unsigned int quadVAO;
+    unsigned int VBO, EBO;
+    // batch state
+    std::vector<SpriteVertex> vertices;
+    unsigned int batchTexture;
+    // statistics
+    unsigned int drawCalls, spriteCount;
     // Initializes and configures the quad's buffer and vertex attributes
     void initRenderData();
 };
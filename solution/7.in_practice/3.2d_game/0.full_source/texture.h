@@ -10,6 +10,7 @@
 #define TEXTURE_H
 
 #include <glad/glad.h>
+#include <glm/glm.hpp>
 
 // Texture2D is able to store and configure a texture in OpenGL.
 // It also hosts utility functions for easy management.
@@ -28,6 +29,8 @@ public:
     unsigned int Wrap_T; // wrapping mode on T axis
     unsigned int Filter_Min; // filtering mode if texture pixels < screen pixels
     unsigned int Filter_Max; // filtering mode if texture pixels > screen pixels
+    // part of the texture object holding the image (u0, v0, u1, v1): the whole texture, or a region of an atlas page
+    glm::vec4 UV_Rect;
     // constructor (sets default texture modes)
     Texture2D();
     // generates texture from image data
@@ -0,0 +1,123 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "texture_atlas.h"
+
+#include <algorithm>
+
+
+TextureAtlas::TextureAtlas(unsigned int pageSize, unsigned int padding)
+    : pageSize(pageSize), padding(padding)
+{
+
+}
+
+bool TextureAtlas::Pack(unsigned int width, unsigned int height, Region &region)
+{
+    unsigned int paddedWidth = width + 2 * this->padding;
+    unsigned int paddedHeight = height + 2 * this->padding;
+    if (paddedWidth > this->pageSize || paddedHeight > this->pageSize)
+        return false;
+
+    // first page with room for the image, else a new page
+    unsigned int page = 0, y = 0;
+    int index = -1;
+    for (; page < this->skylines.size(); ++page)
+    {
+        index = this->findPosition(this->skylines[page], paddedWidth, paddedHeight, y);
+        if (index >= 0)
+            break;
+    }
+    if (index < 0)
+    {
+        SkylineNode ground = { 0, 0, this->pageSize };
+        this->skylines.push_back(std::vector<SkylineNode>(1, ground));
+        page = (unsigned int)this->skylines.size() - 1;
+        index = 0;
+        y = 0;
+    }
+
+    region.Page = page;
+    region.X = this->skylines[page][index].X + this->padding;
+    region.Y = y + this->padding;
+    region.Width = width;
+    region.Height = height;
+    this->addRectangle(this->skylines[page], index, y, paddedWidth, paddedHeight);
+    return true;
+}
+
+unsigned int TextureAtlas::GetUsedHeight(unsigned int page) const
+{
+    unsigned int height = 0;
+    for (const SkylineNode &node : this->skylines[page])
+        height = std::max(height, node.Y);
+    return height;
+}
+
+int TextureAtlas::findPosition(const std::vector<SkylineNode> &skyline, unsigned int width, unsigned int height, unsigned int &y) const
+{
+    int bestIndex = -1;
+    unsigned int bestBottom = 0, bestWidth = 0;
+    for (unsigned int i = 0; i < skyline.size(); ++i)
+    {
+        if (skyline[i].X + width > this->pageSize)
+            break;
+        // the rectangle starts after the filled rows of every segment it spans
+        unsigned int top = 0, covered = 0;
+        for (unsigned int j = i; j < skyline.size() && covered < width; ++j)
+        {
+            top = std::max(top, skyline[j].Y);
+            covered += skyline[j].Width;
+        }
+        if (top + height > this->pageSize)
+            continue;
+        // smallest far edge (top + height), then the narrowest segment to keep wide ones for wide images
+        if (bestIndex < 0 || top + height < bestBottom || (top + height == bestBottom && skyline[i].Width < bestWidth))
+        {
+            bestIndex = (int)i;
+            bestBottom = top + height;
+            bestWidth = skyline[i].Width;
+            y = top;
+        }
+    }
+    return bestIndex;
+}
+
+void TextureAtlas::addRectangle(std::vector<SkylineNode> &skyline, int index, unsigned int y, unsigned int width, unsigned int height)
+{
+    SkylineNode node = { skyline[index].X, y + height, width };
+    skyline.insert(skyline.begin() + index, node);
+
+    // the segments under the rectangle shrink or disappear
+    unsigned int right = node.X + node.Width;
+    for (unsigned int i = index + 1; i < skyline.size(); )
+    {
+        if (skyline[i].X >= right)
+            break;
+        unsigned int shrink = right - skyline[i].X;
+        if (skyline[i].Width <= shrink)
+        {
+            skyline.erase(skyline.begin() + i);
+            continue;
+        }
+        skyline[i].X += shrink;
+        skyline[i].Width -= shrink;
+        break;
+    }
+    // neighbours at the same height become one segment
+    for (unsigned int i = 0; i + 1 < skyline.size(); )
+    {
+        if (skyline[i].Y == skyline[i + 1].Y)
+        {
+            skyline[i].Width += skyline[i + 1].Width;
+            skyline.erase(skyline.begin() + i + 1);
+        }
+        else
+            ++i;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <vector>
+
+
+// TextureAtlas finds the place of images packed in square pages with a
+// skyline bottom-left packer. A page fills from its row 0 and keeps the
+// profile of its filled part as horizontal segments; an image goes where
+// its far edge (Y + height) ends up the smallest, so the filled part of
+// the page grows as little as possible. Every image is surrounded by a border of padding pixels
+// that the caller fills by extruding the image edges, so that filtering
+// never reads the pixels of a neighbouring image.
+// Packing the images from the tallest to the shortest gives the tightest pages.
+class TextureAtlas
+{
+public:
+    // place of a packed image, without its padding
+    struct Region {
+        unsigned int Page;
+        unsigned int X, Y;
+        unsigned int Width, Height;
+    };
+    // constructor
+    TextureAtlas(unsigned int pageSize, unsigned int padding);
+    // finds a place for an image, opening a new page when it fits in none of the current ones. Returns false if the image (with its padding) is larger than a page
+    bool Pack(unsigned int width, unsigned int height, Region &region);
+    // number of pages opened so far
+    unsigned int GetPageCount() const { return (unsigned int)this->skylines.size(); }
+    // height of the filled part of a page (the width is always the page size)
+    unsigned int GetUsedHeight(unsigned int page) const;
+    unsigned int GetPageSize() const { return this->pageSize; }
+    unsigned int GetPadding() const { return this->padding; }
+private:
+    // a horizontal segment of the skyline: the rows [0, Y) of the columns [X, X + Width) are filled, the rows from Y on are free
+    struct SkylineNode {
+        unsigned int X, Y, Width;
+    };
+    unsigned int pageSize;
+    unsigned int padding;
+    std::vector<std::vector<SkylineNode>> skylines;
+    // best place of a width x height rectangle in a page: index of the skyline node it starts on, or -1
+    int findPosition(const std::vector<SkylineNode> &skyline, unsigned int width, unsigned int height, unsigned int &y) const;
+    // raises the skyline over the rectangle placed on a node
+    void addRectangle(std::vector<SkylineNode> &skyline, int index, unsigned int y, unsigned int width, unsigned int height);
+};
+
+#endif
\ No newline at end of file
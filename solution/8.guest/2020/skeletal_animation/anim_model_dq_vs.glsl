@@ -0,0 +1,63 @@
+#version 330 core
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 norm;
+layout(location = 2) in vec2 tex;
+layout(location = 5) in ivec4 boneIds;
+layout(location = 6) in vec4 weights;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+
+const int MAX_BONES = 100;
+const int MAX_BONE_WEIGHTS = 4;
+
+// palette of the character as dual quaternions (real then dual part of each bone), bound as a range of the BonePaletteBuffer
+layout (std140) uniform BonePalette
+{
+    vec4 dualQuaternions[2 * MAX_BONES];
+};
+
+out vec2 TexCoords;
+
+vec3 transformPoint(vec4 real, vec4 dual, vec3 point)
+{
+    vec3 rotated = point + 2.0f * cross(real.xyz, cross(real.xyz, point) + real.w * point);
+    return rotated + 2.0f * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+}
+
+void main()
+{
+    // blend on the hemisphere of the first bone so that the rotations take the shortest path
+    vec4 real = vec4(0.0f);
+    vec4 dual = vec4(0.0f);
+    vec4 pivot = vec4(0.0f);
+    bool unskinned = false;
+    for(int i = 0 ; i < MAX_BONE_WEIGHTS ; i++)
+    {
+        if(boneIds[i] == -1)
+            continue;
+        if(boneIds[i] >= MAX_BONES)
+        {
+            unskinned = true;
+            break;
+        }
+        vec4 boneReal = dualQuaternions[2 * boneIds[i]];
+        vec4 boneDual = dualQuaternions[2 * boneIds[i] + 1];
+        if(pivot == vec4(0.0f))
+            pivot = boneReal;
+        float weight = dot(boneReal, pivot) < 0.0f ? -weights[i] : weights[i];
+        real += boneReal * weight;
+        dual += boneDual * weight;
+    }
+
+    vec3 position = pos;
+    float len = length(real);
+    if(!unskinned && len > 0.0f)
+        position = transformPoint(real / len, dual / len, pos);
+
+    mat4 viewModel = view * model;
+    gl_Position = projection * viewModel * vec4(position, 1.0f);
+    TexCoords = tex;
+}
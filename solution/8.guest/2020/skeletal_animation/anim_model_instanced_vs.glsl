@@ -0,0 +1,49 @@
+#version 330 core
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 norm;
+layout(location = 2) in vec2 tex;
+layout(location = 5) in ivec4 boneIds;
+layout(location = 6) in vec4 weights;
+layout(location = 7) in mat4 instanceMatrix;
+layout(location = 11) in int paletteOffset;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+const int MAX_BONE_WEIGHTS = 4;
+
+// palettes of the whole crowd, one matrix every 4 texels
+uniform samplerBuffer bonePalette;
+uniform int bonesPerCharacter;
+
+out vec2 TexCoords;
+
+mat4 fetchBone(int bone)
+{
+    int texel = (paletteOffset + bone) * 4;
+    return mat4(texelFetch(bonePalette, texel),
+                texelFetch(bonePalette, texel + 1),
+                texelFetch(bonePalette, texel + 2),
+                texelFetch(bonePalette, texel + 3));
+}
+
+void main()
+{
+    vec4 totalPosition = vec4(0.0f);
+    for(int i = 0 ; i < MAX_BONE_WEIGHTS ; i++)
+    {
+        if(boneIds[i] == -1)
+            continue;
+        if(boneIds[i] >= bonesPerCharacter)
+        {
+            totalPosition = vec4(pos, 1.0f);
+            break;
+        }
+        vec4 localPosition = fetchBone(boneIds[i]) * vec4(pos, 1.0f);
+        totalPosition += localPosition * weights[i];
+    }
+
+    gl_Position = projection * view * instanceMatrix * totalPosition;
+    TexCoords = tex;
+}
@@ -0,0 +1,17 @@
+#version 330 core
+
+// vertices skinned once per frame by PreSkinnedCrowd, already in world space
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 norm;
+layout(location = 2) in vec2 tex;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+out vec2 TexCoords;
+
+void main()
+{
+    gl_Position = projection * view * vec4(pos, 1.0f);
+    TexCoords = tex;
+}
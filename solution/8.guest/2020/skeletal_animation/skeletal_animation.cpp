@@ -9,17 +9,34 @@
 #include <learnopengl/shader_m.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/animator.h>
+#include <learnopengl/animation_library.h>
+#include <learnopengl/bone_palette.h>
+#include <learnopengl/animator_pool.h>
+#include <learnopengl/instancing.h>
+#include <learnopengl/spatial_index.h>
+#include <learnopengl/pre_skinning.h>
+#include <learnopengl/pose_sharing.h>
 #include <learnopengl/model_animation.h>
 
 
 
 #include <iostream>
+#include <string>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
+void runAnimationBenchmark(Animation& animation);
+void runThreadScalingBenchmark(Animation& animation);
+void runPoseCacheBenchmark(Animation& animation);
+void runCompressionBenchmark(const Animation& animation);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -31,11 +48,41 @@ float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
+// characters, each with its own animator and palette
+const int CHARACTER_COUNT = 3;
+// default crowd of the stress mode (--stress [count])
+const int STRESS_CHARACTER_COUNT = 2000;
+// texture unit of the palettes of the crowd, above the material textures
+const unsigned int BONE_PALETTE_TEXTURE_UNIT = 8;
+// sampling rate of the baked poses played in cached mode (key C)
+const float POSE_CACHE_RATE = 30.0f;
+bool usePoseCache = false;
+bool poseCacheKeyPressed = false;
+// reduced update rate, leaf bones skipped and off-screen characters frozen by screen size (key L)
+bool useAnimationLOD = true;
+bool animationLODKeyPressed = false;
+// stress mode only (key K): skinning in the vertex shader of every pass, or once per frame by transform feedback or on the CPU
+enum SkinningMode { SKIN_IN_VERTEX_SHADER, SKIN_TRANSFORM_FEEDBACK, SKIN_ON_CPU };
+const char* SKINNING_MODE_NAMES[] = { "Skinning in the vertex shader", "Pre-skinning by transform feedback", "Pre-skinning on the CPU" };
+SkinningMode skinningMode = SKIN_IN_VERTEX_SHADER;
+bool skinningModeKeyPressed = false;
+// palettes of dual quaternions instead of matrices (key Q): half the bytes per bone
+bool useDualQuaternions = false;
+bool dualQuaternionsKeyPressed = false;
+// characters of the same clip in the same time bucket share one pose (key G), the crowd is then spread over a few phases
+const int POSE_SHARING_GROUPS = 16;
+bool usePoseSharing = false;
+bool poseSharingKeyPressed = false;
+// memory of the pre-skinned vertices, the characters beyond it are skinned in the vertex shader
+const size_t PRE_SKINNING_MEMORY_BUDGET = 256 * 1024 * 1024;
+// bounding box of a character around its feet, once scaled down, for the screen size and the visibility of the LOD
+const glm::vec3 CHARACTER_EXTENTS(0.3f, 0.5f, 0.3f);
+
 // timing
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-int main()
+int main(int argc, char* argv[])
 {
 	// glfw: initialize and configure
 	// ------------------------------
@@ -82,14 +129,137 @@ int main()
 
 	// build and compile shaders
 	// -------------------------
-	Shader ourShader("anim_model_vs.glsl", "anim_model_fs.glsl");
+	Shader ourMatrixShader("anim_model_vs.glsl", "anim_model_fs.glsl");
+	Shader crowdMatrixShader("anim_model_instanced_vs.glsl", "anim_model_fs.glsl");
+	Shader ourDualQuaternionShader("anim_model_dq_vs.glsl", "anim_model_fs.glsl");
+	Shader crowdDualQuaternionShader("anim_model_instanced_dq_vs.glsl", "anim_model_fs.glsl");
+	Shader preSkinnedShader("anim_model_preskinned_vs.glsl", "anim_model_fs.glsl");
 
 	
 	// load models
 	// -----------
-	Model ourModel(FileSystem::getPath("resources/objects/vampire/dancing_vampire.dae"));
-	Animation danceAnimation(FileSystem::getPath("resources/objects/vampire/dancing_vampire.dae"),&ourModel);
-	Animator animator(&danceAnimation);
+	// one import for the model and all its clips, then a binary cache that skips Assimp on the next runs. The cache is
+	// machine specific: it is written in the working directory, next to the shaders, not in the shared resources
+	const std::string modelPath = FileSystem::getPath("resources/objects/vampire/dancing_vampire.dae");
+	Model ourModel;
+	AnimationLibrary animations;
+	auto loadStart = std::chrono::high_resolution_clock::now();
+	if (!animations.Load(modelPath, ourModel, "dancing_vampire.animcache") || animations.GetClipCount() == 0)
+	{
+		std::cout << "Failed to load the animated model" << std::endl;
+		glfwTerminate();
+		return -1;
+	}
+	std::cout << "Loaded " << animations.GetClipCount() << " clip(s) " << (animations.WasLoadedFromCache() ? "from the cache" : "with Assimp") << " in "
+		<< std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - loadStart).count() << " ms:";
+	for (const std::string& name : animations.GetClipNames())
+		std::cout << " " << name;
+	std::cout << std::endl;
+	Animation& danceAnimation = *animations.GetClip(0);
+
+	// run with --benchmark to measure the cost of the pose evaluation of one character and exit
+	if (argc > 1 && std::string(argv[1]) == "--benchmark")
+	{
+		runAnimationBenchmark(danceAnimation);
+		glfwTerminate();
+		return 0;
+	}
+
+	// run with --benchmark-threads to measure the update of 1 to 10000 characters on one and on all threads and exit
+	if (argc > 1 && std::string(argv[1]) == "--benchmark-threads")
+	{
+		runThreadScalingBenchmark(danceAnimation);
+		glfwTerminate();
+		return 0;
+	}
+
+	// run with --benchmark-cache to compare the baked pose cache with the live evaluation and exit
+	if (argc > 1 && std::string(argv[1]) == "--benchmark-cache")
+	{
+		runPoseCacheBenchmark(danceAnimation);
+		glfwTerminate();
+		return 0;
+	}
+
+	// run with --benchmark-compression to report the size and the error of the compressed clip and exit
+	if (argc > 1 && std::string(argv[1]) == "--benchmark-compression")
+	{
+		runCompressionBenchmark(danceAnimation);
+		glfwTerminate();
+		return 0;
+	}
+
+	// run with --stress [count] to draw a crowd of vampires: all the palettes in one texture buffer and one
+	// instanced draw per mesh, each instance reading its palette at its own offset
+	const bool stress = argc > 1 && std::string(argv[1]) == "--stress";
+	int characterCount = CHARACTER_COUNT;
+	if (stress)
+	{
+		characterCount = argc > 2 ? std::max(1, atoi(argv[2])) : STRESS_CHARACTER_COUNT;
+		characterCount = std::min(characterCount, BonePaletteBuffer::GetMaxTextureBufferCharacters(ourModel.GetBoneCount()));
+		camera.Position = glm::vec3(0.0f, 4.0f, 0.6f * std::sqrt((float)characterCount) + 3.0f);
+	}
+
+	std::vector<Animator> animators(characterCount, Animator(&danceAnimation));
+	for (int i = 0; i < characterCount; ++i)
+	{
+		animators[i].SetCurrentTime(danceAnimation.GetDuration() * (stress ? (rand() / (float)RAND_MAX) : (float)i / characterCount));
+		animators[i].SetUpdatePhase(i);
+	}
+
+	// the animators write their pose in the mapped palettes, bound per character before its draw or once for the crowd.
+	// Matrices or dual quaternions (key Q), each format with its palettes and its shaders.
+	BonePaletteBuffer matrixPalette(characterCount,
+		stress ? BONE_PALETTE_TEXTURE_BUFFER : BONE_PALETTE_UNIFORM_BUFFER,
+		stress ? BONE_PALETTE_TEXTURE_UNIT : 0,
+		ourModel.GetBoneCount());
+	matrixPalette.AttachShader(stress ? crowdMatrixShader.ID : ourMatrixShader.ID);
+	BonePaletteBuffer dualQuaternionPalette(characterCount,
+		stress ? BONE_PALETTE_TEXTURE_BUFFER : BONE_PALETTE_UNIFORM_BUFFER,
+		stress ? BONE_PALETTE_TEXTURE_UNIT : 0,
+		ourModel.GetBoneCount(), BONE_PALETTE_DUAL_QUATERNIONS);
+	dualQuaternionPalette.AttachShader(stress ? crowdDualQuaternionShader.ID : ourDualQuaternionShader.ID);
+	bool dualQuaternionsUsed = useDualQuaternions;
+
+	AnimatorThreadPool animatorPool;
+	InstanceBatcher crowdBatcher;
+	PoseCache poseCache(&danceAnimation, POSE_CACHE_RATE);
+	bool poseCacheUsed = false;
+
+	// the characters stand in a row, the crowd on a square grid
+	std::vector<glm::mat4> characterTransforms(characterCount);
+	const int crowdSide = static_cast<int>(std::ceil(std::sqrt((float)characterCount)));
+	for (int i = 0; i < characterCount; ++i)
+	{
+		glm::mat4 model = glm::mat4(1.0f);
+		if (stress)
+			model = glm::translate(model, glm::vec3(1.2f * (i % crowdSide - (crowdSide - 1) * 0.5f), -0.4f, -1.2f * (i / crowdSide)));
+		else
+			model = glm::translate(model, glm::vec3(1.2f * (i - (characterCount - 1) * 0.5f), -0.4f, 0.0f)); // translate it down so it's at the center of the scene
+		characterTransforms[i] = glm::scale(model, glm::vec3(.5f, .5f, .5f));	// it's a bit too big for our scene, so scale it down
+	}
+	bool animationLODUsed = useAnimationLOD;
+
+	// the crowd skinned once per frame and drawn as static geometry, as far as the memory budget goes
+	std::unique_ptr<PreSkinnedCrowd> preSkinnedCrowd;
+	std::vector<const glm::mat4*> characterPoses(characterCount);
+	int preSkinnedCount = 0;
+	if (stress)
+	{
+		preSkinnedCount = std::min(characterCount, (int)std::max<size_t>(1, PRE_SKINNING_MEMORY_BUDGET / PreSkinnedCrowd::GetCharacterSize(ourModel)));
+		preSkinnedCrowd.reset(new PreSkinnedCrowd(ourModel, preSkinnedCount, "skinning_tf_vs.glsl"));
+		for (int i = 0; i < characterCount; ++i)
+			characterPoses[i] = animators[i].GetPoseTransforms().data();
+	}
+	SkinningMode skinningModeUsed = skinningMode;
+	PoseSharing poseSharing;
+	bool poseSharingUsed = usePoseSharing;
+	float statsTime = 0.0f;
+	int statsFrames = 0;
+	double statsUpdateMs = 0.0;
+	double statsSkinningMs = 0.0;
+	int statsEvaluations = 0;
+	AnimationLODStats statsLOD;
 
 
 	// draw in wireframe
@@ -108,33 +278,166 @@ int main()
 		// input
 		// -----
 		processInput(window);
-		animator.UpdateAnimation(deltaTime);
+		if (usePoseCache != poseCacheUsed)
+		{
+			for (Animator& animator : animators)
+				animator.SetPoseCache(usePoseCache ? &poseCache : nullptr);
+			poseCacheUsed = usePoseCache;
+			std::cout << (usePoseCache ? "Cached poses" : "Live evaluation") << std::endl;
+		}
+		if (useDualQuaternions != dualQuaternionsUsed)
+		{
+			dualQuaternionsUsed = useDualQuaternions;
+			std::cout << (useDualQuaternions ? "Dual quaternion" : "Matrix") << " skinning" << std::endl;
+		}
+		BonePaletteBuffer& bonePalette = useDualQuaternions ? dualQuaternionPalette : matrixPalette;
+		Shader& ourShader = useDualQuaternions ? ourDualQuaternionShader : ourMatrixShader;
+		Shader& crowdShader = useDualQuaternions ? crowdDualQuaternionShader : crowdMatrixShader;
+
+		if (usePoseSharing != poseSharingUsed)
+		{
+			poseSharingUsed = usePoseSharing;
+			if (usePoseSharing)
+				PoseSharing::AssignPhaseGroups(animators.data(), characterCount, POSE_SHARING_GROUPS);
+			std::cout << "Pose sharing " << (usePoseSharing ? "on" : "off") << std::endl;
+		}
+
+		// pre-skinning reads one matrix palette per character
+		if (!stress || useDualQuaternions || usePoseSharing)
+			skinningMode = SKIN_IN_VERTEX_SHADER;
+		if (skinningMode != skinningModeUsed)
+		{
+			skinningModeUsed = skinningMode;
+			std::cout << SKINNING_MODE_NAMES[skinningMode];
+			if (skinningMode != SKIN_IN_VERTEX_SHADER)
+				std::cout << " (" << preSkinnedCount << " characters, " << PreSkinnedCrowd::GetCharacterSize(ourModel) * preSkinnedCount / (1024 * 1024) << " MB)";
+			std::cout << std::endl;
+		}
+		if (useAnimationLOD != animationLODUsed)
+		{
+			animationLODUsed = useAnimationLOD;
+			std::cout << "Animation LOD " << (useAnimationLOD ? "on" : "off") << std::endl;
+		}
+
+		// view/projection transformations
+		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
+		glm::mat4 view = camera.GetViewMatrix();
+
+		// level of detail of every character from the fraction of the screen height it covers
+		const FrustumPlanes frustum = extractFrustumPlanes(projection * view);
+		const float viewHeight = 2.0f * std::tan(glm::radians(camera.Zoom) * 0.5f);
+		for (int i = 0; i < characterCount; ++i)
+		{
+			AnimationLOD lod;
+			if (useAnimationLOD)
+			{
+				const glm::vec3 center = glm::vec3(characterTransforms[i][3]) + glm::vec3(0.0f, CHARACTER_EXTENTS.y, 0.0f);
+				const float distance = std::max(glm::length(center - camera.Position), 0.001f);
+				const float screenSize = 2.0f * CHARACTER_EXTENTS.y / (distance * viewHeight);
+				lod = SelectAnimationLOD(screenSize, intersectFrustumAABB(frustum, center, CHARACTER_EXTENTS));
+			}
+			animators[i].SetLOD(lod);
+		}
+
+		auto updateStart = std::chrono::high_resolution_clock::now();
+		// if the map fails this frame draws with the palettes left in the buffer
+		const bool paletteMapped = bonePalette.BeginFrame();
+		if (usePoseSharing)
+		{
+			poseSharing.UpdateAnimations(animators.data(), characterCount, deltaTime, bonePalette);
+		}
+		else if (skinningMode == SKIN_ON_CPU)
+		{
+			// the CPU reads the poses back: they stay in the animators, only the characters skinned on the GPU get a palette
+			animatorPool.UpdateAnimations(animators.data(), characterCount, deltaTime);
+			for (int i = preSkinnedCount; paletteMapped && i < characterCount; ++i)
+				std::copy_n(characterPoses[i], bonePalette.GetBonesPerCharacter(), bonePalette.GetPalette(i));
+		}
+		else
+		{
+			animatorPool.UpdateAnimations(animators.data(), characterCount, deltaTime, &bonePalette);
+		}
+		bonePalette.EndFrame();
+		statsUpdateMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - updateStart).count();
+		AnimationLODStats frameLOD;
+		for (const Animator& animator : animators)
+			frameLOD += animator.GetLODStats();
+		statsLOD += frameLOD;
+		statsEvaluations += usePoseSharing ? poseSharing.GetEvaluationCount() : characterCount - frameLOD.interpolatedCharacters - frameLOD.frozenCharacters;
 		
 		// render
 		// ------
 		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// don't forget to enable shader before setting uniforms
-		ourShader.use();
-
-		// view/projection transformations
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		glm::mat4 view = camera.GetViewMatrix();
-		ourShader.setMat4("projection", projection);
-		ourShader.setMat4("view", view);
-
-		auto transforms = animator.GetPoseTransforms();
-		for (int i = 0; i < transforms.size(); ++i)
-			ourShader.setMat4("finalBonesTransformations[" + std::to_string(i) + "]", transforms[i]);
-
-
-		// render the loaded model
-		glm::mat4 model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(0.0f, -0.4f, 0.0f)); // translate it down so it's at the center of the scene
-		model = glm::scale(model, glm::vec3(.5f, .5f, .5f));	// it's a bit too big for our scene, so scale it down
-		ourShader.setMat4("model", model);
-		ourModel.Draw(ourShader);
+		if (stress)
+		{
+			// pre-skinned characters: skinned once, then every pass could draw them like static geometry
+			int firstSkinnedInShader = 0;
+			if (skinningMode != SKIN_IN_VERTEX_SHADER)
+			{
+				auto skinningStart = std::chrono::high_resolution_clock::now();
+				if (skinningMode == SKIN_TRANSFORM_FEEDBACK)
+					preSkinnedCrowd->Skin(characterTransforms.data(), preSkinnedCount, bonePalette);
+				else
+					preSkinnedCrowd->SkinOnCPU(characterTransforms.data(), characterPoses.data(), preSkinnedCount, bonePalette.GetBonesPerCharacter());
+				statsSkinningMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - skinningStart).count();
+
+				preSkinnedShader.use();
+				preSkinnedShader.setMat4("projection", projection);
+				preSkinnedShader.setMat4("view", view);
+				preSkinnedCrowd->Draw(preSkinnedShader);
+				firstSkinnedInShader = preSkinnedCount;
+			}
+
+			// rest of the crowd: one instanced draw per mesh
+			crowdShader.use();
+			crowdShader.setMat4("projection", projection);
+			crowdShader.setMat4("view", view);
+			crowdShader.setInt("bonesPerCharacter", bonePalette.GetBonesPerCharacter());
+			bonePalette.BindFrame();
+			for (int i = firstSkinnedInShader; i < characterCount; ++i)
+				crowdBatcher.add(ourModel, crowdShader, characterTransforms[i], bonePalette.GetPaletteOffset(usePoseSharing ? poseSharing.GetPaletteIndex(i) : i));
+			crowdBatcher.flush();
+		}
+		else
+		{
+			// don't forget to enable shader before setting uniforms
+			ourShader.use();
+			ourShader.setMat4("projection", projection);
+			ourShader.setMat4("view", view);
+
+			// render the loaded model
+			for (int i = 0; i < characterCount; ++i)
+			{
+				bonePalette.BindPalette(usePoseSharing ? poseSharing.GetPaletteIndex(i) : i);
+				ourShader.setMat4("model", characterTransforms[i]);
+				ourModel.Draw(ourShader);
+			}
+		}
+		bonePalette.FenceFrame();
+
+		statsTime += deltaTime;
+		statsFrames++;
+		if (statsTime >= 1.0f)
+		{
+			std::cout << characterCount << " characters : " << statsFrames / statsTime << " fps, animation update "
+				<< statsUpdateMs / statsFrames << " ms, " << statsEvaluations / statsFrames << " pose evaluations per frame, palettes " << bonePalette.GetFrameSize() / 1024 << " KB per frame, bones evaluated " << statsLOD.evaluatedBones / statsFrames
+				<< " / skipped " << statsLOD.skippedBones / statsFrames << " per frame (" << statsLOD.interpolatedCharacters / statsFrames
+				<< " interpolated, " << statsLOD.frozenCharacters / statsFrames << " frozen characters)";
+			if (stress)
+				std::cout << ", " << crowdBatcher.getStats().drawCalls / statsFrames << " draw calls per frame";
+			if (stress && skinningMode != SKIN_IN_VERTEX_SHADER)
+				std::cout << ", pre-skinning " << statsSkinningMs / statsFrames << " ms";
+			std::cout << std::endl;
+			crowdBatcher.resetStats();
+			statsTime = 0.0f;
+			statsFrames = 0;
+			statsUpdateMs = 0.0;
+			statsSkinningMs = 0.0;
+			statsEvaluations = 0;
+			statsLOD = AnimationLODStats();
+		}
 
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
@@ -164,6 +467,267 @@ void processInput(GLFWwindow* window)
 		camera.ProcessKeyboard(LEFT, deltaTime);
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
 		camera.ProcessKeyboard(RIGHT, deltaTime);
+
+	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !poseCacheKeyPressed)
+	{
+		usePoseCache = !usePoseCache;
+		poseCacheKeyPressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE)
+		poseCacheKeyPressed = false;
+
+	if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS && !animationLODKeyPressed)
+	{
+		useAnimationLOD = !useAnimationLOD;
+		animationLODKeyPressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_L) == GLFW_RELEASE)
+		animationLODKeyPressed = false;
+
+	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS && !dualQuaternionsKeyPressed)
+	{
+		useDualQuaternions = !useDualQuaternions;
+		dualQuaternionsKeyPressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_RELEASE)
+		dualQuaternionsKeyPressed = false;
+
+	if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS && !poseSharingKeyPressed)
+	{
+		usePoseSharing = !usePoseSharing;
+		poseSharingKeyPressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_G) == GLFW_RELEASE)
+		poseSharingKeyPressed = false;
+
+	if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS && !skinningModeKeyPressed)
+	{
+		skinningMode = static_cast<SkinningMode>((skinningMode + 1) % 3);
+		skinningModeKeyPressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_K) == GLFW_RELEASE)
+		skinningModeKeyPressed = false;
+}
+
+// evaluate the same frames with the node tree walk (name lookups) and with the compiled skeleton
+// ---------------------------------------------------------------------------------------------
+void runAnimationBenchmark(Animation& animation)
+{
+	const int frameCount = 10000;
+	const float frameTime = 1.0f / 60.0f;
+	Animator reference(&animation);
+	Animator compiled(&animation);
+
+	// both must produce the same pose
+	float maxError = 0.0f;
+	for (int frame = 0; frame < 100; ++frame)
+	{
+		const float time = fmod(frame * 7 * frameTime * animation.GetTicksPerSecond(), animation.GetDuration());
+		reference.SetCurrentTime(time);
+		reference.CalculateBoneTransform(&animation.GetRootNode(), glm::mat4(1.0f));
+		compiled.SetCurrentTime(time);
+		compiled.CalculateBoneTransforms();
+		for (size_t i = 0; i < reference.GetPoseTransforms().size(); ++i)
+			for (int column = 0; column < 4; ++column)
+				maxError = std::max(maxError, glm::length(reference.GetPoseTransforms()[i][column] - compiled.GetPoseTransforms()[i][column]));
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < frameCount; ++frame)
+	{
+		reference.SetCurrentTime(fmod(frame * frameTime * animation.GetTicksPerSecond(), animation.GetDuration()));
+		reference.CalculateBoneTransform(&animation.GetRootNode(), glm::mat4(1.0f));
+	}
+	const double referenceUs = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / frameCount;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < frameCount; ++frame)
+		compiled.UpdateAnimation(frameTime);
+	const double compiledUs = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / frameCount;
+
+	std::cout << "Nodes : " << animation.GetSkeleton().GetNodeCount() << " / Channels : " << animation.GetBones().size() << std::endl;
+	std::cout << "Node tree walk : " << referenceUs << " us per character update" << std::endl;
+	std::cout << "Compiled skeleton : " << compiledUs << " us per character update (max difference " << maxError << ")" << std::endl;
+
+	// per bone: playback moves the key cursors forward, random seeks go through the binary search
+	const std::vector<Bone>& bones = animation.GetBones();
+	std::vector<BoneCursor> cursors(bones.size());
+	std::vector<float> seekTimes(frameCount);
+	for (float& time : seekTimes)
+		time = animation.GetDuration() * (rand() / (float)RAND_MAX);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < frameCount; ++frame)
+	{
+		const float time = fmod(frame * frameTime * animation.GetTicksPerSecond(), animation.GetDuration());
+		for (size_t i = 0; i < bones.size(); ++i)
+			bones[i].Evaluate(time, cursors[i]);
+	}
+	const double playbackNs = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count() / (frameCount * bones.size());
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < frameCount; ++frame)
+	{
+		for (size_t i = 0; i < bones.size(); ++i)
+			bones[i].Evaluate(seekTimes[frame], cursors[i]);
+	}
+	const double seekNs = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count() / (frameCount * bones.size());
+
+	std::cout << "Bone update : " << playbackNs << " ns during playback / " << seekNs << " ns after a seek" << std::endl;
+}
+
+// update batches of characters sharing the same clip with one thread and with the thread pool
+// --------------------------------------------------------------------------------------------
+void runThreadScalingBenchmark(Animation& animation)
+{
+	const float frameTime = 1.0f / 60.0f;
+	AnimatorThreadPool serial(1);
+	AnimatorThreadPool parallel;
+	std::cout << "Threads : " << parallel.GetThreadCount() << std::endl;
+
+	const int characterCounts[] = { 1, 10, 100, 1000, 10000 };
+	for (int characterCount : characterCounts)
+	{
+		std::vector<Animator> animators(characterCount, Animator(&animation));
+		for (int i = 0; i < characterCount; ++i)
+			animators[i].SetCurrentTime(animation.GetDuration() * i / characterCount);
+
+		// about one second of work per measure, at least 10 frames
+		const int frameCount = std::max(10, 100000 / characterCount);
+		double ms[2];
+		AnimatorThreadPool* pools[2] = { &serial, &parallel };
+		for (int p = 0; p < 2; ++p)
+		{
+			pools[p]->UpdateAnimations(animators.data(), characterCount, frameTime);
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int frame = 0; frame < frameCount; ++frame)
+				pools[p]->UpdateAnimations(animators.data(), characterCount, frameTime);
+			ms[p] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / frameCount;
+		}
+
+		std::cout << characterCount << " characters : " << ms[0] << " ms on 1 thread / " << ms[1] << " ms on "
+			<< parallel.GetThreadCount() << " threads (x" << ms[0] / ms[1] << ")" << std::endl;
+	}
+}
+
+// bake the clip at several rates: memory, bake time, error against the live evaluation and update time
+// ---------------------------------------------------------------------------------------------------
+void runPoseCacheBenchmark(Animation& animation)
+{
+	const int frameCount = 10000;
+	const float frameTime = 1.0f / 60.0f;
+
+	Animator live(&animation);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < frameCount; ++frame)
+		live.UpdateAnimation(frameTime);
+	const double liveUs = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / frameCount;
+	std::cout << "Live evaluation : " << liveUs << " us per character update" << std::endl;
+
+	const float rates[] = { 10.0f, 15.0f, 30.0f, 60.0f };
+	for (float rate : rates)
+	{
+		start = std::chrono::high_resolution_clock::now();
+		PoseCache cache(&animation, rate);
+		const double bakeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		// error of the bone matrices at times between the samples, in model units
+		Animator reference(&animation);
+		std::vector<glm::mat4> cached(MAX_BONES, glm::mat4(1.0f));
+		float maxTranslationError = 0.0f, maxAxisError = 0.0f;
+		double sumTranslationError = 0.0;
+		const int errorSamples = 1000;
+		for (int i = 0; i < errorSamples; ++i)
+		{
+			const float time = animation.GetDuration() * (i + 0.5f) / errorSamples;
+			reference.SetCurrentTime(time);
+			reference.CalculateBoneTransforms();
+			cache.Sample(time, cached.data());
+			for (int bone = 0; bone < cache.GetBoneCount(); ++bone)
+			{
+				const glm::mat4& expected = reference.GetPoseTransforms()[bone];
+				const float translationError = glm::length(glm::vec3(expected[3] - cached[bone][3]));
+				maxTranslationError = std::max(maxTranslationError, translationError);
+				sumTranslationError += translationError;
+				for (int column = 0; column < 3; ++column)
+					maxAxisError = std::max(maxAxisError, glm::length(glm::vec3(expected[column] - cached[bone][column])));
+			}
+		}
+
+		Animator cachedAnimator(&animation);
+		cachedAnimator.SetPoseCache(&cache);
+		start = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < frameCount; ++frame)
+			cachedAnimator.UpdateAnimation(frameTime);
+		const double cachedUs = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / frameCount;
+
+		std::cout << rate << " samples/s : " << cache.GetFrameCount() << " frames, " << cache.GetMemorySize() / 1024.0 << " KB, baked in "
+			<< bakeMs << " ms, " << cachedUs << " us per character update (x" << liveUs / cachedUs << "), translation error max "
+			<< maxTranslationError << " / mean " << sumTranslationError / (errorSamples * cache.GetBoneCount())
+			<< ", axis error max " << maxAxisError << std::endl;
+	}
+}
+
+// compress copies of the clip with several tolerances: size, error of the final bone matrices and update time
+// ------------------------------------------------------------------------------------------------------------
+void runCompressionBenchmark(const Animation& animation)
+{
+	const int frameCount = 10000;
+	const float frameTime = 1.0f / 60.0f;
+	const float tolerances[] = { 0.0001f, 0.001f, 0.01f };
+
+	Animation raw = animation;
+	Animator rawAnimator(&raw);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < frameCount; ++frame)
+		rawAnimator.UpdateAnimation(frameTime);
+	const double rawUs = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / frameCount;
+
+	for (float tolerance : tolerances)
+	{
+		BoneCompressionSettings settings;
+		settings.positionTolerance = tolerance;
+		settings.rotationTolerance = tolerance;
+		settings.scaleTolerance = tolerance;
+
+		Animation compressed = animation;
+		start = std::chrono::high_resolution_clock::now();
+		const AnimationCompressionReport report = compressed.Compress(settings);
+		const double compressMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		// error of the final bone matrices, in model units
+		Animator reference(&raw);
+		Animator sampled(&compressed);
+		float maxTranslationError = 0.0f, maxAxisError = 0.0f;
+		const int errorSamples = 2000;
+		for (int i = 0; i < errorSamples; ++i)
+		{
+			const float time = animation.GetDuration() * i / errorSamples;
+			reference.SetCurrentTime(time);
+			reference.CalculateBoneTransforms();
+			sampled.SetCurrentTime(time);
+			sampled.CalculateBoneTransforms();
+			for (size_t bone = 0; bone < reference.GetPoseTransforms().size(); ++bone)
+			{
+				const glm::mat4& expected = reference.GetPoseTransforms()[bone];
+				const glm::mat4& actual = sampled.GetPoseTransforms()[bone];
+				maxTranslationError = std::max(maxTranslationError, glm::length(glm::vec3(expected[3] - actual[3])));
+				for (int column = 0; column < 3; ++column)
+					maxAxisError = std::max(maxAxisError, glm::length(glm::vec3(expected[column] - actual[column])));
+			}
+		}
+
+		Animator compressedAnimator(&compressed);
+		start = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < frameCount; ++frame)
+			compressedAnimator.UpdateAnimation(frameTime);
+		const double compressedUs = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / frameCount;
+
+		std::cout << "Tolerance " << tolerance << " : keys " << report.keysBefore << " -> " << report.keysAfter << ", "
+			<< report.bytesBefore / 1024.0 << " KB -> " << report.bytesAfter / 1024.0 << " KB (x" << (double)report.bytesBefore / report.bytesAfter
+			<< ") in " << compressMs << " ms, translation error max " << maxTranslationError << ", axis error max " << maxAxisError
+			<< ", " << compressedUs << " us per character update (raw " << rawUs << " us)" << std::endl;
+	}
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -0,0 +1,56 @@
+#version 330 core
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 norm;
+layout(location = 2) in vec2 tex;
+layout(location = 3) in vec3 tangent;
+layout(location = 5) in ivec4 boneIds;
+layout(location = 6) in vec4 weights;
+
+const int MAX_BONE_WEIGHTS = 4;
+
+// palettes of the whole crowd and model matrices of the characters, one matrix every 4 texels
+uniform samplerBuffer bonePalette;
+uniform samplerBuffer modelMatrices;
+uniform int bonesPerCharacter;
+
+// captured by transform feedback, interleaved in the order of PreSkinnedVertex
+out vec3 outPosition;
+out vec3 outNormal;
+out vec2 outTexCoords;
+out vec3 outTangent;
+
+mat4 fetchMatrix(samplerBuffer matrices, int index)
+{
+    int texel = index * 4;
+    return mat4(texelFetch(matrices, texel),
+                texelFetch(matrices, texel + 1),
+                texelFetch(matrices, texel + 2),
+                texelFetch(matrices, texel + 3));
+}
+
+void main()
+{
+    // one instance per character
+    int paletteOffset = gl_InstanceID * bonesPerCharacter;
+    mat4 skin = mat4(0.0f);
+    for(int i = 0 ; i < MAX_BONE_WEIGHTS ; i++)
+    {
+        if(boneIds[i] == -1)
+            continue;
+        if(boneIds[i] >= bonesPerCharacter)
+        {
+            skin = mat4(1.0f);
+            break;
+        }
+        skin += fetchMatrix(bonePalette, paletteOffset + boneIds[i]) * weights[i];
+    }
+
+    mat4 world = fetchMatrix(modelMatrices, gl_InstanceID) * skin;
+    outPosition = vec3(world * vec4(pos, 1.0f));
+    vec3 normal = mat3(world) * norm;
+    outNormal = dot(normal, normal) > 0.0f ? normalize(normal) : normal;
+    outTexCoords = tex;
+    outTangent = mat3(world) * tangent;
+    gl_Position = vec4(outPosition, 1.0f);
+}
@@ -357,8 +357,9 @@ int main(){
         transforms.push_back(transform);
 
     }
-    transforms[0].scale = glm::vec3(0.1f, 0.1f, 0.1f);
+    transforms[0].SetScale(glm::vec3(0.1f, 0.1f, 0.1f));
     // transforms[6].scale = glm::vec3(0.2f, 2.0f, 1.0f);
+    // the hierarchy keeps pointers: the vector must not grow from now on
     for (int i = 1; i < NUM_BOXES + 1; i++){
         transforms[i].SetParent(transforms[i-1]);
     }
@@ -392,60 +393,55 @@ int main(){
         // perform Transform in LOCAL SPACE
         // DO NOT COMBINE WITH OTHERS AT HERE.
 
-        glm::quat root_rotation = transforms[0].rotation;
+        glm::quat root_rotation = transforms[0].GetRotation();
 
 
         if (lastFrame < 3.0f){
             for (int i = 1; i < NUM_BOXES + 1; i++){
-                Transform current = transforms[i];
+                Transform & current = transforms[i];
 
-                glm::vec3 pos = current.position + glm::vec3(0.0f, deltaTime / 12, 0.0f);
+                glm::vec3 pos = current.GetPosition() + glm::vec3(0.0f, deltaTime / 12, 0.0f);
                 if (i == 1){
                     pos += glm::vec3(0.0f, deltaTime / 6, 0.0f);
                 }
                 
-                current.position = pos;
+                current.SetPosition(pos);
 
                 // // slerp between angle 0 and desginated ANGLE
                 // glm::quat rot = glm::slerp(glm::quat(glm::vec3(0.0f)),
                 //                          glm::quat(glm::vec3(0.0f, angle, 0.0f)), lastFrame / 3);             
                 
-                // current.rotation = rot;
-
-                // copy back to original vector
-                transforms[i] = current;
+                // current.SetRotation(rot);
             } 
         }
 
         else if (lastFrame < 9.0f)
         {
-            transforms[0].position -= glm::vec3(0.0f, deltaTime/24, 0.0f);
-            transforms[1].rotation = glm::slerp(glm::quat(glm::vec3(0.0f)),
-                                         glm::quat(glm::vec3(0.0f, 0.0f, -(glm::half_pi<float>() + angle))), (lastFrame-3 )/ 6);        
+            transforms[0].SetPosition(transforms[0].GetPosition() - glm::vec3(0.0f, deltaTime/24, 0.0f));
+            transforms[1].SetRotation(glm::slerp(glm::quat(glm::vec3(0.0f)),
+                                         glm::quat(glm::vec3(0.0f, 0.0f, -(glm::half_pi<float>() + angle))), (lastFrame-3 )/ 6));        
             int i = ((static_cast<int>((lastFrame - 3) * 2)));
             if (i > 1 and i < 13){
-                Transform current = transforms[i];
+                Transform & current = transforms[i];
 
-                current.position -= glm::vec3(0.0f, deltaTime / 12, 0.0f);
+                current.SetPosition(current.GetPosition() - glm::vec3(0.0f, deltaTime / 12, 0.0f));
 
                 // slerp between angle 0 and desginated ANGLE
                 glm::quat rot = glm::slerp(glm::quat(glm::vec3(0.0f)),
                                          glm::quat(glm::vec3(0.0f, 0.0f, -angle)), ((lastFrame-3.0f)*2 - i));             
                 
-                current.rotation = rot;
-
-                // if (i > 0) current.pivot = glm::vec3(0.0f, -0.5f, 0.0f);
+                current.SetRotation(rot);
 
-                transforms[i] = current;
+                // if (i > 0) current.SetPivot(glm::vec3(0.0f, -0.5f, 0.0f));
             }
 
 
 
         }
         else if (lastFrame < 21.0f){
-            transforms[0].pivot = -transforms[0].position;
-            transforms[0].rotation = glm::slerp(glm::quat(glm::vec3(0.0f)),
-                                         glm::quat(glm::vec3(0.0f, 0.0f, -glm::half_pi<float>())), (lastFrame-9 )/ 3);
+            transforms[0].SetPivot(-transforms[0].GetPosition());
+            transforms[0].SetRotation(glm::slerp(glm::quat(glm::vec3(0.0f)),
+                                         glm::quat(glm::vec3(0.0f, 0.0f, -glm::half_pi<float>())), (lastFrame-9 )/ 3));
         }
         // else if (lastFrame < 21.0f){
         //     transforms[0].pivot = glm::vec3(0.0f, 0.5f, 0.0f);
@@ -554,7 +550,7 @@ int main(){
         for (unsigned int i = 7; i < NUM_BOXES+1; i++)
         {
             // calculate the model matrix for each object and pass it to shader before drawing
-            glm::mat4 model = transforms[i].GetWorldMatrix(); // Calculating model matrix in top-down manner will save calculation.
+            glm::mat4 model = transforms[i].GetWorldMatrix(); // cached: only recomputed when the box or one of its parents changed
             
             simpleShader.setMat4("model", model);
             glDrawElements(GL_TRIANGLES, cylinder_indices.size(), GL_UNSIGNED_INT, 0);
@@ -6,21 +6,16 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <iostream>
+#include <vector>
+#include <algorithm>
 
+// Local values are only changed through the setters, which bump the local version and mark the world cache of the
+// node and of its whole subtree as dirty. Local and world matrices are recomputed lazily on the next query, so in
+// steady state every Get is O(1) instead of walking the parent chain.
+// Children are kept by pointer: a Transform must not move in memory while it is in a hierarchy.
 class Transform{
     public:
 
-        Transform * parent;
-        std::vector<Transform> children;
-        glm::vec3 position;
-        glm::quat rotation;
-        glm::vec3 scale;
-        glm::vec3 pivot;
-
-        glm::vec2 shear_x;
-        glm::vec2 shear_y;
-        glm::vec2 shear_z;
-
         Transform(){
             parent = NULL;
             position = glm::vec3(0.0f);
@@ -33,96 +28,208 @@ class Transform{
             shear_z = glm::vec2(0.0f);
         }
 
-                
-        glm::mat4 GetMatrix(){
-            return GetMatrixWithoutShear() * GetShearMatrix();
+        // copies only the local values: the copy is not part of the hierarchy
+        Transform(const Transform & other) : Transform(){
+            CopyLocal(other);
+        }
+
+        // copies only the local values: the hierarchy of this transform is kept
+        Transform & operator=(const Transform & other){
+            if (this != &other)
+                CopyLocal(other);
+            return *this;
         }
 
+        ~Transform(){
+            if (parent != NULL)
+                parent->RemoveChild(this);
+            for (Transform * child : children){
+                child->parent = NULL;
+                child->MarkWorldDirty();
+            }
+        }
 
-        glm::mat4 GetMatrixWithoutShear(){
-            glm::mat4 TR = GetMatrixRaw();
-            glm::mat4 TRS = ScalePivot(TR, scale);
-            
-            return TRS;
+        void SetPosition(const glm::vec3 & value){ position = value; MarkLocalDirty(); }
+        void SetRotation(const glm::quat & value){ rotation = value; MarkLocalDirty(); }
+        void SetScale(const glm::vec3 & value){ scale = value; MarkLocalDirty(); }
+        void SetPivot(const glm::vec3 & value){ pivot = value; MarkLocalDirty(); }
+        void SetShear(const glm::vec2 & x, const glm::vec2 & y, const glm::vec2 & z){
+            shear_x = x;
+            shear_y = y;
+            shear_z = z;
+            MarkLocalDirty();
         }
-        glm::mat4 GetMatrixRaw(){
-            glm::mat4 T = glm::translate(glm::mat4(1.0f), position);
-            glm::mat4 TR = RotatePivot(T, rotation);
 
-            return TR;
+        const glm::vec3 & GetPosition() const { return position; }
+        const glm::quat & GetRotation() const { return rotation; }
+        const glm::vec3 & GetScale() const { return scale; }
+        const glm::vec3 & GetPivot() const { return pivot; }
+        Transform * GetParent() const { return parent; }
+        const std::vector<Transform *> & GetChildren() const { return children; }
+
+        // incremented by every change of the local values
+        unsigned int GetLocalVersion() const { return localVersion; }
+        // incremented every time the world values are recomputed, after a change of this node or of an ancestor
+        unsigned int GetWorldVersion() const { return worldVersion; }
+
+
+        const glm::mat4 & GetMatrix(){
+            UpdateLocal();
+            return localMatrix;
+        }
+
+
+        const glm::mat4 & GetMatrixWithoutShear(){
+            UpdateLocal();
+            return localMatrixWithoutShear;
+        }
+        const glm::mat4 & GetMatrixRaw(){
+            UpdateLocal();
+            return localMatrixRaw;
         }
 
         void SetParent(Transform & t){
+            if (parent != NULL)
+                parent->RemoveChild(this);
             parent = &t;
-            t.children.push_back(*this);
+            t.children.push_back(this);
+            MarkWorldDirty();
         }
 
         glm::mat4 GetRawTranslation(){
             return glm::translate(glm::mat4(1.0f), position);
-        }        
+        }
         glm::mat4 GetTranslation(){
             return glm::translate(GetRawTranslation(), -pivot);
         }
 
-        glm::mat4 GetWorldMatrix(){
-            glm::mat4 world = GetMatrixRaw();
-            glm::vec3 worldScale = scale;
-            Transform * iter = parent;
-
-            while (iter != NULL){
-                glm::mat4 parentM = iter->GetMatrixRaw();
-                glm::vec3 parentScale = iter->scale;
-
-                world = parentM * world;
-                worldScale.x = parentScale.x * worldScale.x;
-                worldScale.y = parentScale.y * worldScale.y;
-                worldScale.z = parentScale.z * worldScale.z;
-
-                iter = iter->parent;
-
-            }
-
-            world = ScalePivot(world, worldScale);
-            world = world * GetShearMatrix();
-            
-            return world;
+        // the raw (translation and rotation) matrices of the chain, then the product of the scales around the pivot, then the shear
+        const glm::mat4 & GetWorldMatrix(){
+            UpdateWorld();
+            return worldMatrix;
         }
 
-        glm::quat GetWorldRotation(){
-            glm::quat worldRotation = rotation;
-            Transform * iter = parent;
-            
-            while (iter != NULL){
-                worldRotation = iter->rotation * worldRotation;
-                iter = iter->parent;
-            }
+        const glm::quat & GetWorldRotation(){
+            UpdateWorld();
             return worldRotation;
         }
 
-        glm::vec3 GetWorldPosition(){
-            glm::vec3 worldPosition = position;
-            Transform * iter = parent;
-            while (iter != NULL){
-                worldPosition = worldPosition * iter->scale;
-                worldPosition = worldPosition * iter->rotation;
-                worldPosition += iter->position;
-
-                iter = iter->parent;
-            }
+        const glm::vec3 & GetWorldPosition(){
+            UpdateWorld();
             return worldPosition;
         }
 
         void SetWorldRotation(glm::quat rot){
             if (parent == NULL){
-                rotation = rot;
+                SetRotation(rot);
                 return;
             }
             glm::quat parentWorld = parent->GetWorldRotation();
             glm::quat inv = glm::inverse(parentWorld);
-            rotation = inv * rot;
+            SetRotation(inv * rot);
         }
 
     private:
+        // hierarchy
+        Transform * parent;
+        std::vector<Transform *> children;
+
+        // local values
+        glm::vec3 position;
+        glm::quat rotation;
+        glm::vec3 scale;
+        glm::vec3 pivot;
+
+        glm::vec2 shear_x;
+        glm::vec2 shear_y;
+        glm::vec2 shear_z;
+
+        // local cache, valid when localCacheVersion == localVersion
+        unsigned int localVersion = 1;
+        unsigned int localCacheVersion = 0;
+        glm::mat4 localMatrixRaw = glm::mat4(1.0f);
+        glm::mat4 localMatrixWithoutShear = glm::mat4(1.0f);
+        glm::mat4 localMatrix = glm::mat4(1.0f);
+
+        // world cache, valid when worldDirty is false. If a node is dirty all its descendants are dirty too.
+        bool worldDirty = true;
+        unsigned int worldVersion = 0;
+        glm::mat4 worldMatrixRaw = glm::mat4(1.0f);
+        glm::vec3 worldScale = glm::vec3(1.0f);
+        glm::mat4 worldMatrix = glm::mat4(1.0f);
+        glm::quat worldRotation = glm::identity<glm::quat>();
+        glm::vec3 worldPosition = glm::vec3(0.0f);
+        // maps a position local to this node to the world: scale, then inverse rotation, then translation, up to the root
+        glm::mat4 worldPositionTransform = glm::mat4(1.0f);
+
+        void CopyLocal(const Transform & other){
+            position = other.position;
+            rotation = other.rotation;
+            scale = other.scale;
+            pivot = other.pivot;
+            shear_x = other.shear_x;
+            shear_y = other.shear_y;
+            shear_z = other.shear_z;
+            MarkLocalDirty();
+        }
+
+        void RemoveChild(Transform * child){
+            children.erase(std::remove(children.begin(), children.end(), child), children.end());
+        }
+
+        void MarkLocalDirty(){
+            ++localVersion;
+            MarkWorldDirty();
+        }
+
+        void MarkWorldDirty(){
+            // a dirty node already has a dirty subtree
+            if (worldDirty)
+                return;
+            worldDirty = true;
+            for (Transform * child : children)
+                child->MarkWorldDirty();
+        }
+
+        void UpdateLocal(){
+            if (localCacheVersion == localVersion)
+                return;
+
+            glm::mat4 T = glm::translate(glm::mat4(1.0f), position);
+            localMatrixRaw = RotatePivot(T, rotation);
+            localMatrixWithoutShear = ScalePivot(localMatrixRaw, scale);
+            localMatrix = localMatrixWithoutShear * GetShearMatrix();
+            localCacheVersion = localVersion;
+        }
+
+        void UpdateWorld(){
+            if (!worldDirty)
+                return;
+
+            UpdateLocal();
+            // scale, then v * q (rotation by the inverse of q), then translation
+            glm::mat4 positionTransform = glm::translate(glm::mat4(1.0f), position) * glm::toMat4(glm::inverse(rotation)) * glm::scale(glm::mat4(1.0f), scale);
+            if (parent != NULL){
+                parent->UpdateWorld();
+                worldMatrixRaw = parent->worldMatrixRaw * localMatrixRaw;
+                worldScale = parent->worldScale * scale;
+                worldRotation = parent->worldRotation * rotation;
+                worldPosition = glm::vec3(parent->worldPositionTransform * glm::vec4(position, 1.0f));
+                worldPositionTransform = parent->worldPositionTransform * positionTransform;
+            }
+            else{
+                worldMatrixRaw = localMatrixRaw;
+                worldScale = scale;
+                worldRotation = rotation;
+                worldPosition = position;
+                worldPositionTransform = positionTransform;
+            }
+            worldMatrix = ScalePivot(worldMatrixRaw, worldScale) * GetShearMatrix();
+
+            worldDirty = false;
+            ++worldVersion;
+        }
+
         glm::mat4 RotatePivot(glm::mat4 T, glm::quat rotation){
             return glm::translate(glm::translate(T, pivot) * glm::toMat4(rotation), -pivot);
         }
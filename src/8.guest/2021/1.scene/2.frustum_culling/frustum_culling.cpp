@@ -27,7 +27,13 @@ public:
 
 
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <chrono>
+#include <random>
 
+int runSpatialIndexBenchmark();
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
@@ -37,6 +43,25 @@ void processInput(GLFWwindow* window);
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
+// occlusion culling
+enum OcclusionMode {
+	OCCLUSION_NONE,
+	OCCLUSION_SOFTWARE, // occluders rasterized on the CPU
+	OCCLUSION_HIZ       // two phase test against the Hi-Z pyramid of the depth buffer
+};
+const size_t MAX_OCCLUDERS = 16;
+OcclusionMode occlusionMode = OCCLUSION_SOFTWARE;
+bool occlusionSoftwareKeyPressed = false;
+bool occlusionHiZKeyPressed = false;
+
+// entities sharing a model are drawn with one instanced draw per mesh
+bool instancing = true;
+bool instancingKeyPressed = false;
+
+// picking with a ray from the camera through the spatial index
+bool pickRequested = false;
+bool pickKeyPressed = false;
+
 // camera
 Camera camera(glm::vec3(0.0f, 10.0f, 0.0f));
 Camera cameraSpy(glm::vec3(0.0f, 10.0f, 0.f));
@@ -48,8 +73,12 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-int main()
+int main(int argc, char* argv[])
 {
+	// run with --benchmark-spatial to compare the spatial index queries with linear scans, without opening a window
+	if (argc > 1 && std::string(argv[1]) == "--benchmark-spatial")
+		return runSpatialIndexBenchmark();
+
 	// glfw: initialize and configure
 	// ------------------------------
 	glfwInit();
@@ -98,10 +127,13 @@ int main()
 	// build and compile shaders
 	// -------------------------
 	Shader ourShader("1.model_loading.vs", "1.model_loading.fs");
+	Shader instancedShader("1.model_loading_instanced.vs", "1.model_loading.fs");
+	InstanceBatcher batcher;
 
 	// load entities
 	// -----------
 	Model model(FileSystem::getPath("resources/objects/planet/planet.obj"));
+	LooseOctree<Entity> spatialIndex(glm::vec3(0.f), 128.f); // must outlive the entities registered in it
 	Entity ourEntity(model);
 	ourEntity.transform.setLocalPosition({ 0, 0, 0 });
 	const float scale = 1.0;
@@ -123,6 +155,41 @@ int main()
 		}
 	}
 	ourEntity.updateSelfAndChild();
+	ourEntity.registerSelfAndChild(spatialIndex);
+	std::vector<SpatialQueryResult<Entity>> pickResults;
+
+	// occluders
+	// ---------
+	// the planet is a sphere: the box inscribed in its bounding sphere never goes past its silhouette
+	const AABB planetAABB = generateAABB(model);
+	const float inscribedExtent = std::min(std::min(planetAABB.extents.x, planetAABB.extents.y), planetAABB.extents.z) / std::sqrt(3.f);
+	const OccluderMesh planetOccluder = OccluderMesh::createBox(planetAABB.center, glm::vec3(inscribedExtent));
+	OcclusionCuller occlusionCuller;
+
+	// scene framebuffer: the Hi-Z pyramid is built from its depth texture
+	// -------------------------------------------------------------------
+	unsigned int sceneFBO;
+	glGenFramebuffers(1, &sceneFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+	unsigned int sceneColor, sceneDepth;
+	glGenTextures(1, &sceneColor);
+	glBindTexture(GL_TEXTURE_2D, sceneColor);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneColor, 0);
+	glGenTextures(1, &sceneDepth);
+	glBindTexture(GL_TEXTURE_2D, sceneDepth);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, SCR_WIDTH, SCR_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); // no mipmap: the texture must be complete to be read by the pyramid
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, sceneDepth, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "Framebuffer not complete!" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	HiZPyramid hiZ(SCR_WIDTH, SCR_HEIGHT, true);
+	std::vector<Entity*> hiZOccluded;
 
 	// draw in wireframe
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -143,6 +210,8 @@ int main()
 
 		// render
 		// ------
+		glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+		glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -161,11 +230,100 @@ int main()
 
 		ourShader.setMat4("projection", projection);
 		ourShader.setMat4("view", view);
-
-		// draw our scene graph
+		instancedShader.use();
+		instancedShader.setMat4("projection", projection);
+		instancedShader.setMat4("view", view);
+
+		// draw our scene graph, queued in the batcher when instancing
+		Shader& drawShader = instancing ? instancedShader : ourShader;
+		InstanceBatcher* drawBatcher = instancing ? &batcher : nullptr;
+		batcher.resetStats();
+		drawShader.use();
 		unsigned int total = 0, display = 0;
-		ourEntity.drawSelfAndChild(camFrustum, ourShader, display, total);
-		std::cout << "Total process in CPU : " << total << " / Total send to GPU : " << display << std::endl;
+		if (occlusionMode == OCCLUSION_SOFTWARE)
+		{
+			// the nearest planets inside the frustum are rendered as occluders
+			std::vector<Entity*> occluders;
+			for (auto&& child : ourEntity.children)
+			{
+				if (child->boundingVolume->isOnFrustum(camFrustum, child->transform))
+					occluders.push_back(child.get());
+			}
+			const size_t occluderCount = std::min(occluders.size(), MAX_OCCLUDERS);
+			std::partial_sort(occluders.begin(), occluders.begin() + occluderCount, occluders.end(), [](const Entity* lhs, const Entity* rhs)
+				{
+					const glm::vec3 lhsToCamera = lhs->transform.getGlobalPosition() - camera.Position;
+					const glm::vec3 rhsToCamera = rhs->transform.getGlobalPosition() - camera.Position;
+					return glm::dot(lhsToCamera, lhsToCamera) < glm::dot(rhsToCamera, rhsToCamera);
+				});
+
+			occlusionCuller.beginFrame(projection * view);
+			for (size_t i = 0; i < occluderCount; ++i)
+				occlusionCuller.renderOccluder(planetOccluder, occluders[i]->transform.getModelMatrix());
+			occlusionCuller.endOccluders();
+
+			ourEntity.drawSelfAndChild(camFrustum, occlusionCuller, drawShader, display, total, drawBatcher);
+			batcher.flush();
+
+			const OcclusionStats& stats = occlusionCuller.getStats();
+			std::cout << "Total process in CPU : " << total << " / Total send to GPU : " << display
+				<< " / Occluded : " << stats.occluded << " / Cull time : " << stats.rasterTimeMs + stats.testTimeMs << " ms" << std::endl;
+		}
+		else if (occlusionMode == OCCLUSION_HIZ)
+		{
+			// phase 1 against the pyramid of the previous frame, phase 2 against the one of the depth drawn by phase 1
+			HiZStats stats;
+			hiZOccluded.clear();
+			ourEntity.drawSelfAndChild(camFrustum, hiZ, drawShader, hiZOccluded, stats, total, drawBatcher);
+			batcher.flush();
+			hiZ.build(sceneDepth, projection * view);
+			drawShader.use();
+			Entity::drawDisoccluded(hiZOccluded, hiZ, drawShader, stats, drawBatcher);
+			batcher.flush();
+
+			display = stats.firstPhaseDrawn + stats.secondPhaseDrawn;
+			std::cout << "Total process in CPU : " << total << " / Total send to GPU : " << display
+				<< " / Hi-Z drawn : " << stats.firstPhaseDrawn << " + " << stats.secondPhaseDrawn << " disoccluded / Hi-Z culled : " << stats.culled << std::endl;
+		}
+		else
+		{
+			ourEntity.drawSelfAndChild(camFrustum, drawShader, display, total, drawBatcher);
+			batcher.flush();
+			std::cout << "Total process in CPU : " << total << " / Total send to GPU : " << display << std::endl;
+		}
+
+		if (instancing)
+		{
+			const InstancingStats& instancingStats = batcher.getStats();
+			std::cout << "Instancing : " << instancingStats.instances << " instances in " << instancingStats.batches << " batches / Draw calls : "
+				<< instancingStats.drawCalls << " (" << instancingStats.drawCallsWithoutInstancing << " without instancing)" << std::endl;
+		}
+		else
+		{
+			std::cout << "Instancing : off / Draw calls : " << display * model.meshes.size() << std::endl;
+		}
+
+		if (pickRequested)
+		{
+			spatialIndex.queryRay(camera.Position, camera.Front, 100.f, pickResults);
+			if (pickResults.empty())
+				std::cout << "Picking : nothing" << std::endl;
+			else
+			{
+				const glm::vec3 picked = pickResults.front().object->transform.getGlobalPosition();
+				std::cout << "Picking : entity at (" << picked.x << ", " << picked.y << ", " << picked.z << ") at distance "
+					<< pickResults.front().distance << " / " << pickResults.size() << " entities on the ray" << std::endl;
+			}
+			pickRequested = false;
+		}
+
+		// copy the scene to the default framebuffer
+		int framebufferWidth, framebufferHeight;
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, framebufferWidth, framebufferHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
 		//ourEntity.transform.setLocalRotation({ 0.f, ourEntity.transform.getLocalRotation().y + 20 * deltaTime, 0.f });
 		ourEntity.updateSelfAndChild();
@@ -176,6 +334,10 @@ int main()
 		glfwPollEvents();
 	}
 
+	glDeleteFramebuffers(1, &sceneFBO);
+	glDeleteTextures(1, &sceneColor);
+	glDeleteTextures(1, &sceneDepth);
+
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
 	glfwTerminate();
@@ -197,6 +359,46 @@ void processInput(GLFWwindow* window)
 		camera.ProcessKeyboard(LEFT, deltaTime);
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
 		camera.ProcessKeyboard(RIGHT, deltaTime);
+
+	if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS && !occlusionSoftwareKeyPressed)
+	{
+		occlusionMode = occlusionMode == OCCLUSION_SOFTWARE ? OCCLUSION_NONE : OCCLUSION_SOFTWARE;
+		occlusionSoftwareKeyPressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_O) == GLFW_RELEASE)
+	{
+		occlusionSoftwareKeyPressed = false;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS && !occlusionHiZKeyPressed)
+	{
+		occlusionMode = occlusionMode == OCCLUSION_HIZ ? OCCLUSION_NONE : OCCLUSION_HIZ;
+		occlusionHiZKeyPressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_H) == GLFW_RELEASE)
+	{
+		occlusionHiZKeyPressed = false;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS && !instancingKeyPressed)
+	{
+		instancing = !instancing;
+		instancingKeyPressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_I) == GLFW_RELEASE)
+	{
+		instancingKeyPressed = false;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS && !pickKeyPressed)
+	{
+		pickRequested = true;
+		pickKeyPressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE)
+	{
+		pickKeyPressed = false;
+	}
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -234,3 +436,196 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
 	camera.ProcessMouseScroll(yoffset);
 }
+
+// spatial index benchmark: random boxes queried through the loose octree and with linear scans
+// ---------------------------------------------------------------------------------------------
+struct BenchmarkObject
+{
+	glm::vec3 center;
+	glm::vec3 extents;
+};
+
+template<typename TFunction>
+double measureMs(TFunction function)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+	function();
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int runSpatialIndexBenchmark()
+{
+	const float worldHalfSize = 1000.f;
+	const unsigned int queryCount = 100;
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> positionDistribution(-worldHalfSize, worldHalfSize);
+	std::uniform_real_distribution<float> extentDistribution(0.5f, 5.f);
+	std::uniform_real_distribution<float> unitDistribution(-1.f, 1.f);
+
+	for (unsigned int objectCount : { 10000u, 100000u, 1000000u })
+	{
+		std::vector<BenchmarkObject> objects(objectCount);
+		for (BenchmarkObject& object : objects)
+		{
+			object.center = glm::vec3(positionDistribution(random), positionDistribution(random), positionDistribution(random));
+			object.extents = glm::vec3(extentDistribution(random));
+		}
+
+		LooseOctree<BenchmarkObject> octree(glm::vec3(0.f), worldHalfSize);
+		std::vector<unsigned int> handles(objectCount);
+		const double buildMs = measureMs([&]()
+			{
+				for (unsigned int i = 0; i < objectCount; ++i)
+					handles[i] = octree.insert(&objects[i], objects[i].center, objects[i].extents);
+			});
+
+		const double updateMs = measureMs([&]()
+			{
+				for (unsigned int i = 0; i < objectCount; ++i)
+				{
+					objects[i].center += glm::vec3(unitDistribution(random), unitDistribution(random), unitDistribution(random));
+					octree.update(handles[i], objects[i].center, objects[i].extents);
+				}
+			});
+
+		std::cout << objectCount << " objects : build " << buildMs << " ms / move all " << updateMs << " ms" << std::endl;
+
+		std::vector<SpatialQueryResult<BenchmarkObject>> results;
+		std::vector<SpatialQueryResult<BenchmarkObject>> linearResults;
+		const auto sortLinear = [&]()
+		{
+			std::sort(linearResults.begin(), linearResults.end(), [](const SpatialQueryResult<BenchmarkObject>& lhs, const SpatialQueryResult<BenchmarkObject>& rhs)
+				{
+					return lhs.distance < rhs.distance;
+				});
+		};
+		const auto report = [&](const char* name, double octreeMs, double linearMs, size_t octreeHits, size_t linearHits)
+		{
+			std::cout << "  " << name << " : octree " << octreeMs / queryCount << " ms / linear " << linearMs / queryCount << " ms per query, "
+				<< octreeHits / queryCount << " hits" << (octreeHits == linearHits ? "" : " (MISMATCH)") << std::endl;
+		};
+
+		// the query parameters are drawn before timing so both sides answer the same queries
+		std::vector<glm::vec3> points(queryCount), directions(queryCount);
+		for (unsigned int q = 0; q < queryCount; ++q)
+		{
+			points[q] = glm::vec3(positionDistribution(random), positionDistribution(random), positionDistribution(random));
+			directions[q] = glm::normalize(glm::vec3(unitDistribution(random), unitDistribution(random), unitDistribution(random)) + glm::vec3(1e-3f));
+		}
+
+		// sphere
+		const float radius = 50.f;
+		size_t octreeHits = 0, linearHits = 0;
+		double octreeMs = measureMs([&]()
+			{
+				for (const glm::vec3& point : points)
+				{
+					octree.querySphere(point, radius, results);
+					octreeHits += results.size();
+				}
+			});
+		double linearMs = measureMs([&]()
+			{
+				for (const glm::vec3& point : points)
+				{
+					linearResults.clear();
+					for (BenchmarkObject& object : objects)
+					{
+						const float distance = distancePointAABB(point, object.center, object.extents);
+						if (distance <= radius)
+							linearResults.push_back({ &object, distance });
+					}
+					sortLinear();
+					linearHits += linearResults.size();
+				}
+			});
+		report("sphere", octreeMs, linearMs, octreeHits, linearHits);
+
+		// AABB
+		const glm::vec3 boxExtents(50.f);
+		octreeHits = linearHits = 0;
+		octreeMs = measureMs([&]()
+			{
+				for (const glm::vec3& point : points)
+				{
+					octree.queryAABB(point, boxExtents, results);
+					octreeHits += results.size();
+				}
+			});
+		linearMs = measureMs([&]()
+			{
+				for (const glm::vec3& point : points)
+				{
+					linearResults.clear();
+					for (BenchmarkObject& object : objects)
+					{
+						if (intersectAABBAABB(point, boxExtents, object.center, object.extents))
+							linearResults.push_back({ &object, distancePointAABB(point, object.center, object.extents) });
+					}
+					sortLinear();
+					linearHits += linearResults.size();
+				}
+			});
+		report("AABB", octreeMs, linearMs, octreeHits, linearHits);
+
+		// frustum of a camera placed at the point and looking along the direction
+		std::vector<FrustumPlanes> frustums(queryCount);
+		const glm::mat4 projection = glm::perspective(glm::radians(45.f), 4.f / 3.f, 0.1f, 300.f);
+		for (unsigned int q = 0; q < queryCount; ++q)
+			frustums[q] = extractFrustumPlanes(projection * glm::lookAt(points[q], points[q] + directions[q], glm::vec3(0.f, 1.f, 0.f)));
+		octreeHits = linearHits = 0;
+		octreeMs = measureMs([&]()
+			{
+				for (unsigned int q = 0; q < queryCount; ++q)
+				{
+					octree.queryFrustum(frustums[q], points[q], results);
+					octreeHits += results.size();
+				}
+			});
+		linearMs = measureMs([&]()
+			{
+				for (unsigned int q = 0; q < queryCount; ++q)
+				{
+					linearResults.clear();
+					for (BenchmarkObject& object : objects)
+					{
+						if (intersectFrustumAABB(frustums[q], object.center, object.extents))
+							linearResults.push_back({ &object, distancePointAABB(points[q], object.center, object.extents) });
+					}
+					sortLinear();
+					linearHits += linearResults.size();
+				}
+			});
+		report("frustum", octreeMs, linearMs, octreeHits, linearHits);
+
+		// ray
+		const float maxDistance = std::numeric_limits<float>::max();
+		octreeHits = linearHits = 0;
+		octreeMs = measureMs([&]()
+			{
+				for (unsigned int q = 0; q < queryCount; ++q)
+				{
+					octree.queryRay(points[q], directions[q], maxDistance, results);
+					octreeHits += results.size();
+				}
+			});
+		linearMs = measureMs([&]()
+			{
+				for (unsigned int q = 0; q < queryCount; ++q)
+				{
+					const glm::vec3 invDirection = 1.f / directions[q];
+					linearResults.clear();
+					for (BenchmarkObject& object : objects)
+					{
+						float distance;
+						if (intersectRayAABB(points[q], invDirection, maxDistance, object.center, object.extents, distance))
+							linearResults.push_back({ &object, distance });
+					}
+					sortLinear();
+					linearHits += linearResults.size();
+				}
+			});
+		report("ray", octreeMs, linearMs, octreeHits, linearHits);
+	}
+	return 0;
+}
@@ -0,0 +1,147 @@
+#version 430 core
+layout (local_size_x = 64) in;
+
+struct Instance
+{
+    mat4 model;
+    vec4 boundingSphere; // xyz: world space center, w: radius
+};
+
+struct DrawElementsIndirectCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    uint baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Instances
+{
+    Instance instances[];
+};
+
+layout (std430, binding = 1) writeonly buffer VisibleInstances
+{
+    mat4 visibleModels[];
+};
+
+layout (std430, binding = 2) buffer DrawCommands
+{
+    DrawElementsIndirectCommand commands[];
+};
+
+layout (std430, binding = 3) buffer FirstPhase
+{
+    uint handledInFirstPhase[]; // 1 if drawn or outside the frustum in phase 0, 0 if rejected by the Hi-Z test
+};
+
+uniform uint instanceCount;
+uniform uint commandCount;
+uniform bool frustumCulling;
+uniform vec4 frustumPlanes[6]; // xyz: normal pointing inside, w: distance
+
+// two phase occlusion culling: phase 0 tests against the Hi-Z pyramid of the previous frame and draws with the first commandCount
+// commands, phase 1 tests the rejected instances against the pyramid rebuilt from the depth of phase 0 and draws with the next ones
+uniform uint phase;
+uniform bool hiZCulling;
+uniform bool hiZBuilt;
+uniform sampler2D hiZ;
+uniform mat4 hiZViewProjection;
+uniform vec2 depthSize;
+uniform int hiZLevels;
+
+bool isOnFrustum(vec4 sphere)
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        if (dot(frustumPlanes[i].xyz, sphere.xyz) + frustumPlanes[i].w < -sphere.w)
+            return false;
+    }
+    return true;
+}
+
+// same test as HiZPyramid::isVisible on the CPU, with the bounding box of the sphere
+bool isUnoccluded(vec4 sphere)
+{
+    if (!hiZCulling || !hiZBuilt)
+        return true;
+
+    vec3 minScreen = vec3(1.0);
+    vec3 maxScreen = vec3(0.0);
+    for (int i = 0; i < 8; ++i)
+    {
+        vec3 corner = sphere.xyz + vec3((i & 1) != 0 ? sphere.w : -sphere.w, (i & 2) != 0 ? sphere.w : -sphere.w, (i & 4) != 0 ? sphere.w : -sphere.w);
+        vec4 clip = hiZViewProjection * vec4(corner, 1.0);
+        if (clip.w <= 1e-5)
+            return true; // crossing the near plane
+        vec3 screen = clip.xyz / clip.w * 0.5 + 0.5;
+        minScreen = min(minScreen, screen);
+        maxScreen = max(maxScreen, screen);
+    }
+    minScreen = clamp(minScreen, 0.0, 1.0);
+    maxScreen = clamp(maxScreen, 0.0, 1.0);
+    if (minScreen.x >= maxScreen.x || minScreen.y >= maxScreen.y)
+        return true;
+
+    // level where the rectangle covers at most 2 * 2 texels (level 0 is half the depth resolution)
+    vec2 sizeInPixels = (maxScreen.xy - minScreen.xy) * depthSize;
+    int level = clamp(int(ceil(log2(max(max(sizeInPixels.x, sizeInPixels.y), 1.0)))) - 1, 0, hiZLevels - 1);
+    // pixels first, then their texels: the last texel of a level also covers the odd leftover of the previous one
+    ivec2 lastPixel = ivec2(depthSize) - 1;
+    ivec2 minPixel = min(ivec2(minScreen.xy * depthSize), lastPixel);
+    ivec2 maxPixel = min(ivec2(maxScreen.xy * depthSize), lastPixel);
+    ivec2 size = textureSize(hiZ, level);
+    ivec2 minTexel = min(minPixel >> (level + 1), size - 1);
+    ivec2 maxTexel = min(maxPixel >> (level + 1), size - 1);
+    for (int y = minTexel.y; y <= maxTexel.y; ++y)
+    {
+        for (int x = minTexel.x; x <= maxTexel.x; ++x)
+        {
+            if (minScreen.z <= texelFetch(hiZ, ivec2(x, y), level).r)
+                return true;
+        }
+    }
+    return false;
+}
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+
+    // the instances of phase 1 are stored after the ones of phase 0, whose count is final once phase 0 is done
+    if (phase == 1u && index == 0u)
+    {
+        for (uint i = 0u; i < commandCount; ++i)
+            commands[commandCount + i].baseInstance = commands[0].instanceCount;
+    }
+
+    if (index >= instanceCount)
+        return;
+
+    if (phase == 0u)
+    {
+        if (frustumCulling && !isOnFrustum(instances[index].boundingSphere))
+        {
+            handledInFirstPhase[index] = 1u;
+            return;
+        }
+        bool visible = isUnoccluded(instances[index].boundingSphere);
+        handledInFirstPhase[index] = visible ? 1u : 0u;
+        if (!visible)
+            return;
+    }
+    else if (handledInFirstPhase[index] != 0u || !isUnoccluded(instances[index].boundingSphere))
+    {
+        return;
+    }
+
+    // every mesh of the model draws the same instances: only the first command of the phase is counted, one atomic per
+    // visible instance, and its count is copied to the other commands once the phase is done
+    uint firstCommand = phase * commandCount;
+    uint slot = atomicAdd(commands[firstCommand].instanceCount, 1u);
+    if (phase == 1u)
+        slot += commands[0].instanceCount;
+
+    visibleModels[slot] = instances[index].model;
+}
@@ -0,0 +1,507 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/shader_m.h>
+#include <learnopengl/shader_c.h>
+#include <learnopengl/camera.h>
+#include <learnopengl/model.h>
+#include <learnopengl/hiz_culling.h>
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <limits>
+#include <cstddef>
+
+void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void mouse_callback(GLFWwindow* window, double xpos, double ypos);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void processInput(GLFWwindow* window);
+
+// settings
+const unsigned int SCR_WIDTH = 800;
+const unsigned int SCR_HEIGHT = 600;
+
+// camera
+Camera camera(glm::vec3(0.0f, 0.0f, 155.0f));
+float lastX = (float)SCR_WIDTH / 2.0;
+float lastY = (float)SCR_HEIGHT / 2.0;
+bool firstMouse = true;
+
+// timing
+float deltaTime = 0.0f;
+float lastFrame = 0.0f;
+
+// culling
+bool frustumCulling = true;
+bool frustumCullingKeyPressed = false;
+bool hiZCulling = true;
+bool hiZCullingKeyPressed = false;
+
+// per instance data read by the culling compute shader (std430 layout)
+struct InstanceData
+{
+	glm::mat4 model;
+	glm::vec4 boundingSphere; // xyz: world space center, w: radius
+};
+
+// layout expected by glDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+	unsigned int count;
+	unsigned int instanceCount;
+	unsigned int firstIndex;
+	unsigned int baseVertex;
+	unsigned int baseInstance;
+};
+
+// extract the 6 planes of the frustum from the view projection matrix (Gribb/Hartmann), normals point inside
+std::array<glm::vec4, 6> extractFrustumPlanes(const glm::mat4& viewProjection)
+{
+	const glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+	const glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+	const glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+	const glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+	std::array<glm::vec4, 6> planes = { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row3 + row2, row3 - row2 };
+	for (glm::vec4& plane : planes)
+		plane /= glm::length(glm::vec3(plane));
+	return planes;
+}
+
+int main()
+{
+	// glfw: initialize and configure
+	// ------------------------------
+	// compute shaders and indirect draws need OpenGL 4.3 (Mesa's llvmpipe provides it: run with LIBGL_ALWAYS_SOFTWARE=1 to test without a GPU)
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+#ifdef __APPLE__
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+	// glfw window creation
+	// --------------------
+	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+	if (window == NULL)
+	{
+		std::cout << "Failed to create GLFW window (OpenGL 4.3 is required)" << std::endl;
+		glfwTerminate();
+		return -1;
+	}
+	glfwMakeContextCurrent(window);
+	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+	glfwSetCursorPosCallback(window, mouse_callback);
+	glfwSetScrollCallback(window, scroll_callback);
+
+	// tell GLFW to capture our mouse
+	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+	// glad: load all OpenGL function pointers
+	// ---------------------------------------
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		return -1;
+	}
+	if (!GLAD_GL_VERSION_4_3)
+	{
+		std::cout << "OpenGL 4.3 is required for compute shaders and indirect draws" << std::endl;
+		glfwTerminate();
+		return -1;
+	}
+
+	// configure global opengl state
+	// -----------------------------
+	glEnable(GL_DEPTH_TEST);
+
+	// build and compile shaders
+	// -------------------------
+	Shader asteroidShader("3.asteroids.vs", "3.asteroids.fs");
+	Shader planetShader("3.planet.vs", "3.planet.fs");
+	ComputeShader cullingShader("3.gpu_culling.cs");
+
+	// load models
+	// -----------
+	Model rock(FileSystem::getPath("resources/objects/rock/rock.obj"));
+	Model planet(FileSystem::getPath("resources/objects/planet/planet.obj"));
+
+	// bounding sphere of the rock in local space
+	glm::vec3 minRock(std::numeric_limits<float>::max());
+	glm::vec3 maxRock(std::numeric_limits<float>::lowest());
+	for (const Mesh& mesh : rock.meshes)
+	{
+		for (const Vertex& vertex : mesh.vertices)
+		{
+			minRock = glm::min(minRock, vertex.Position);
+			maxRock = glm::max(maxRock, vertex.Position);
+		}
+	}
+	const glm::vec3 rockCenter = (minRock + maxRock) * 0.5f;
+	const float rockRadius = glm::length(maxRock - rockCenter);
+
+	// generate a large list of semi-random model transformation matrices
+	// ------------------------------------------------------------------
+	const unsigned int amount = 100000;
+	std::vector<InstanceData> instances(amount);
+	srand(glfwGetTime()); // initialize random seed
+	float radius = 150.0;
+	float offset = 25.0f;
+	for (unsigned int i = 0; i < amount; i++)
+	{
+		glm::mat4 model = glm::mat4(1.0f);
+		// 1. translation: displace along circle with 'radius' in range [-offset, offset]
+		float angle = (float)i / (float)amount * 360.0f;
+		float displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
+		float x = sin(angle) * radius + displacement;
+		displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
+		float y = displacement * 0.4f; // keep height of asteroid field smaller compared to width of x and z
+		displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
+		float z = cos(angle) * radius + displacement;
+		model = glm::translate(model, glm::vec3(x, y, z));
+
+		// 2. scale: Scale between 0.05 and 0.25f
+		float scale = (rand() % 20) / 100.0f + 0.05;
+		model = glm::scale(model, glm::vec3(scale));
+
+		// 3. rotation: add random rotation around a (semi)randomly picked rotation axis vector
+		float rotAngle = (rand() % 360);
+		model = glm::rotate(model, rotAngle, glm::vec3(0.4f, 0.6f, 0.8f));
+
+		// 4. now add to list of instances with the bounding sphere in world space
+		instances[i].model = model;
+		instances[i].boundingSphere = glm::vec4(glm::vec3(model * glm::vec4(rockCenter, 1.0f)), rockRadius * scale);
+	}
+
+	// configure the culling buffers
+	// -----------------------------
+	// all instances, never touched again by the CPU
+	unsigned int instanceBuffer;
+	glGenBuffers(1, &instanceBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, amount * sizeof(InstanceData), instances.data(), GL_STATIC_DRAW);
+
+	// model matrices of the instances that survived the culling, written by the compute shader and read as instanced vertex attributes
+	unsigned int visibleBuffer;
+	glGenBuffers(1, &visibleBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, amount * sizeof(glm::mat4), NULL, GL_DYNAMIC_COPY);
+
+	// one indirect draw per mesh of the rock and per occlusion culling phase, the compute shader fills the instance counts
+	const unsigned int commandCount = (unsigned int)rock.meshes.size();
+	std::vector<DrawElementsIndirectCommand> resetCommands;
+	for (unsigned int phase = 0; phase < 2; phase++)
+	{
+		for (const Mesh& mesh : rock.meshes)
+			resetCommands.push_back({ (unsigned int)mesh.indices.size(), 0, 0, 0, 0 });
+	}
+
+	unsigned int commandBuffer;
+	glGenBuffers(1, &commandBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, resetCommands.size() * sizeof(DrawElementsIndirectCommand), resetCommands.data(), GL_DYNAMIC_DRAW);
+
+	// the compute shader only counts the instances in the first command of a phase, the commands of the other meshes get
+	// that count copied on the GPU once the phase is done
+	auto copyInstanceCount = [&](unsigned int phase)
+	{
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		glBindBuffer(GL_COPY_READ_BUFFER, commandBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, commandBuffer);
+		const GLintptr countOffset = phase * commandCount * sizeof(DrawElementsIndirectCommand) + offsetof(DrawElementsIndirectCommand, instanceCount);
+		for (unsigned int i = 1; i < commandCount; i++)
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, countOffset, countOffset + i * sizeof(DrawElementsIndirectCommand), sizeof(unsigned int));
+	};
+
+	// instances settled by the first occlusion culling phase, the second phase only tests the others
+	unsigned int firstPhaseBuffer;
+	glGenBuffers(1, &firstPhaseBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, firstPhaseBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, amount * sizeof(unsigned int), NULL, GL_DYNAMIC_COPY);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibleBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, firstPhaseBuffer);
+
+	// render the scene in a framebuffer with a depth texture, the Hi-Z pyramid is built from it between the two phases
+	// -----------------------------------------------------------------------------------------------------------------
+	unsigned int sceneFBO;
+	glGenFramebuffers(1, &sceneFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+	unsigned int sceneColor;
+	glGenTextures(1, &sceneColor);
+	glBindTexture(GL_TEXTURE_2D, sceneColor);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneColor, 0);
+	unsigned int sceneDepth;
+	glGenTextures(1, &sceneDepth);
+	glBindTexture(GL_TEXTURE_2D, sceneDepth);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, SCR_WIDTH, SCR_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, sceneDepth, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "Framebuffer not complete!" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	HiZPyramid hiZ(SCR_WIDTH, SCR_HEIGHT);
+
+	// set the visible transformation matrices as an instance vertex attribute (with divisor 1)
+	// ----------------------------------------------------------------------------------------
+	glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+	for (unsigned int i = 0; i < rock.meshes.size(); i++)
+	{
+		unsigned int VAO = rock.meshes[i].VAO;
+		glBindVertexArray(VAO);
+		// set attribute pointers for matrix (4 times vec4)
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)0);
+		glEnableVertexAttribArray(4);
+		glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4)));
+		glEnableVertexAttribArray(5);
+		glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(2 * sizeof(glm::vec4)));
+		glEnableVertexAttribArray(6);
+		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(3 * sizeof(glm::vec4)));
+
+		glVertexAttribDivisor(3, 1);
+		glVertexAttribDivisor(4, 1);
+		glVertexAttribDivisor(5, 1);
+		glVertexAttribDivisor(6, 1);
+
+		glBindVertexArray(0);
+	}
+
+	// render loop
+	// -----------
+	float statsTimer = 0.0f;
+	unsigned int statsFrames = 0;
+	while (!glfwWindowShouldClose(window))
+	{
+		// per-frame time logic
+		// --------------------
+		float currentFrame = glfwGetTime();
+		deltaTime = currentFrame - lastFrame;
+		lastFrame = currentFrame;
+
+		// input
+		// -----
+		processInput(window);
+
+		// configure transformation matrices
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
+		glm::mat4 view = camera.GetViewMatrix();
+
+		// cull (phase 0) against the Hi-Z pyramid of the previous frame
+		// -------------------------------------------------------------
+		// reset the instance counts (the CPU only writes the commands, the visibility is only read back for the stats)
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, resetCommands.size() * sizeof(DrawElementsIndirectCommand), resetCommands.data());
+
+		const std::array<glm::vec4, 6> frustumPlanes = extractFrustumPlanes(projection * view);
+		cullingShader.use();
+		glUniform1ui(glGetUniformLocation(cullingShader.ID, "instanceCount"), amount);
+		glUniform1ui(glGetUniformLocation(cullingShader.ID, "commandCount"), commandCount);
+		cullingShader.setBool("frustumCulling", frustumCulling);
+		glUniform4fv(glGetUniformLocation(cullingShader.ID, "frustumPlanes"), 6, glm::value_ptr(frustumPlanes[0]));
+		cullingShader.setBool("hiZCulling", hiZCulling);
+		cullingShader.setInt("hiZ", 1);
+		cullingShader.setVec2("depthSize", glm::vec2(SCR_WIDTH, SCR_HEIGHT));
+		cullingShader.setInt("hiZLevels", (int)hiZ.getLevelCount());
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, hiZ.getTexture());
+		cullingShader.setBool("hiZBuilt", hiZ.isBuilt());
+		cullingShader.setMat4("hiZViewProjection", hiZ.getViewProjection());
+		glUniform1ui(glGetUniformLocation(cullingShader.ID, "phase"), 0);
+		glDispatchCompute((amount + 63) / 64, 1, 1);
+		copyInstanceCount(0);
+
+		// the draws read the commands and the visible matrices written above, phase 1 reads the instances settled by phase 0
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+		// render
+		// ------
+		glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+		glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		asteroidShader.use();
+		asteroidShader.setMat4("projection", projection);
+		asteroidShader.setMat4("view", view);
+		planetShader.use();
+		planetShader.setMat4("projection", projection);
+		planetShader.setMat4("view", view);
+
+		// draw planet
+		glm::mat4 model = glm::mat4(1.0f);
+		model = glm::translate(model, glm::vec3(0.0f, -3.0f, 0.0f));
+		model = glm::scale(model, glm::vec3(4.0f, 4.0f, 4.0f));
+		planetShader.setMat4("model", model);
+		planet.Draw(planetShader);
+
+		// draw meteorites visible in the previous frame
+		asteroidShader.use();
+		asteroidShader.setInt("texture_diffuse1", 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, rock.textures_loaded[0].id);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		for (unsigned int i = 0; i < rock.meshes.size(); i++)
+		{
+			glBindVertexArray(rock.meshes[i].VAO);
+			glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(i * sizeof(DrawElementsIndirectCommand)));
+			glBindVertexArray(0);
+		}
+
+		if (hiZCulling)
+		{
+			// cull (phase 1) the rejected instances against the pyramid of the depth drawn so far, and draw the disoccluded ones
+			// -------------------------------------------------------------------------------------------------------------------
+			hiZ.build(sceneDepth, projection * view);
+
+			cullingShader.use();
+			cullingShader.setBool("hiZBuilt", true);
+			cullingShader.setMat4("hiZViewProjection", hiZ.getViewProjection());
+			glUniform1ui(glGetUniformLocation(cullingShader.ID, "phase"), 1);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, hiZ.getTexture());
+			glDispatchCompute((amount + 63) / 64, 1, 1);
+			copyInstanceCount(1);
+			glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+			asteroidShader.use();
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, rock.textures_loaded[0].id);
+			for (unsigned int i = 0; i < rock.meshes.size(); i++)
+			{
+				glBindVertexArray(rock.meshes[i].VAO);
+				glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)((commandCount + i) * sizeof(DrawElementsIndirectCommand)));
+				glBindVertexArray(0);
+			}
+		}
+
+		// show the scene
+		int framebufferWidth, framebufferHeight;
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, framebufferWidth, framebufferHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		// print the average frame time every second
+		statsTimer += deltaTime;
+		statsFrames++;
+		if (statsTimer >= 1.0f)
+		{
+			// reading the counts back stalls the pipeline, only once per second
+			DrawElementsIndirectCommand firstPhase, secondPhase;
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+			glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawElementsIndirectCommand), &firstPhase);
+			glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, commandCount * sizeof(DrawElementsIndirectCommand), sizeof(DrawElementsIndirectCommand), &secondPhase);
+			std::cout << "Frustum culling : " << (frustumCulling ? "GPU" : "off") << " / Hi-Z culling : " << (hiZCulling ? "GPU" : "off")
+				<< " / Drawn : " << firstPhase.instanceCount << " + " << secondPhase.instanceCount << " disoccluded / Culled : "
+				<< amount - firstPhase.instanceCount - secondPhase.instanceCount << " / Frame time : " << statsTimer * 1000.0f / statsFrames << " ms" << std::endl;
+			statsTimer = 0.0f;
+			statsFrames = 0;
+		}
+
+		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		// -------------------------------------------------------------------------------
+		glfwSwapBuffers(window);
+		glfwPollEvents();
+	}
+
+	glDeleteBuffers(1, &instanceBuffer);
+	glDeleteBuffers(1, &visibleBuffer);
+	glDeleteBuffers(1, &commandBuffer);
+	glDeleteBuffers(1, &firstPhaseBuffer);
+	glDeleteFramebuffers(1, &sceneFBO);
+	glDeleteTextures(1, &sceneColor);
+	glDeleteTextures(1, &sceneDepth);
+
+	glfwTerminate();
+	return 0;
+}
+
+// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// ---------------------------------------------------------------------------------------------------------
+void processInput(GLFWwindow* window)
+{
+	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+		glfwSetWindowShouldClose(window, true);
+
+	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+		camera.ProcessKeyboard(FORWARD, deltaTime);
+	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+		camera.ProcessKeyboard(BACKWARD, deltaTime);
+	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+		camera.ProcessKeyboard(LEFT, deltaTime);
+	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+		camera.ProcessKeyboard(RIGHT, deltaTime);
+
+	if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS && !frustumCullingKeyPressed)
+	{
+		frustumCulling = !frustumCulling;
+		frustumCullingKeyPressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_F) == GLFW_RELEASE)
+	{
+		frustumCullingKeyPressed = false;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS && !hiZCullingKeyPressed)
+	{
+		hiZCulling = !hiZCulling;
+		hiZCullingKeyPressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_H) == GLFW_RELEASE)
+	{
+		hiZCullingKeyPressed = false;
+	}
+}
+
+// glfw: whenever the window size changed (by OS or user resize) this callback function executes
+// ---------------------------------------------------------------------------------------------
+void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+	// make sure the viewport matches the new window dimensions; note that width and
+	// height will be significantly larger than specified on retina displays.
+	glViewport(0, 0, width, height);
+}
+
+// glfw: whenever the mouse moves, this callback is called
+// -------------------------------------------------------
+void mouse_callback(GLFWwindow* window, double xpos, double ypos)
+{
+	if (firstMouse)
+	{
+		lastX = xpos;
+		lastY = ypos;
+		firstMouse = false;
+	}
+
+	float xoffset = xpos - lastX;
+	float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
+
+	lastX = xpos;
+	lastY = ypos;
+
+	camera.ProcessMouseMovement(xoffset, yoffset);
+}
+
+// glfw: whenever the mouse scroll wheel scrolls, this callback is called
+// ----------------------------------------------------------------------
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+	camera.ProcessMouseScroll(yoffset);
+}